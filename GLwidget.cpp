@@ -49,14 +49,23 @@
 ****************************************************************************/
 
 #include "GLwidget.h"
+#include "utilities.h"
 #include <QMouseEvent>
+#include <QPainter>
 #include <math.h>
 
 
+// Orientation samples kept for the playout (seconds at 1 kHz)
+#define HISTORY_SIZE 2048
+
+
 GLWidget::GLWidget(QWidget *parent)
     : QOpenGLWidget(parent)
     , geometries(0)
     , texture(0)
+    , history(HISTORY_SIZE)
+    , playoutDelayUs(0)
+    , shownMicros(0)
 {
     setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
 }
@@ -84,9 +93,83 @@ GLWidget::sizeHint() const {
 }
 
 
+// The samples are painted playoutDelay() behind their time stamps
+// (micros() clock), interpolated between the two bracketing ones:
+// the cube moves at the display rate whatever the arrival jitter.
+void
+GLWidget::addRotation(quint64 sampleMicros, float q0, float q1, float q2, float q3) {
+    OrientationSample sample;
+    // Time stamps out of order would break the search in playout()
+    if(!history.isEmpty() && sampleMicros < history.last().micros)
+        sampleMicros = history.last().micros;
+    sample.micros   = sampleMicros;
+    sample.rotation = QQuaternion(q0, q1, q2, q3).normalized();
+    history.append(sample);
+}
+
+
+// 0: the newest sample is painted as soon as it arrives
 void
-GLWidget::setRotation(float q0, float q1, float q2, float q3) {
-    rotation = QQuaternion(q0, q1, q2, q3);
+GLWidget::setPlayoutDelay(int msDelay) {
+    playoutDelayUs = quint64(qMax(0, msDelay))*1000;
+}
+
+
+int
+GLWidget::playoutDelay() const {
+    return int(playoutDelayUs/1000);
+}
+
+
+// The model (OBJ or STL) shown instead of the cube: to be set before
+// the widget is first shown
+void
+GLWidget::setMeshFile(QString sFileName) {
+    sMeshFile = sFileName;
+}
+
+
+// Slerp between the samples around (now - delay). Before the first
+// sample the oldest one is held, after the newest the newest.
+void
+GLWidget::playout(quint64 now) {
+    if(history.isEmpty()) return;
+    quint64 t = now > playoutDelayUs ? now-playoutDelayUs : 0;
+    if(playoutDelayUs == 0 || t >= history.last().micros) {
+        rotation    = history.last().rotation;
+        shownMicros = history.last().micros;
+        return;
+    }
+    if(t <= history.first().micros) {
+        rotation    = history.first().rotation;
+        shownMicros = history.first().micros;
+        return;
+    }
+    // First sample after t
+    int iLow = 0, iHigh = history.count()-1;
+    while(iLow < iHigh) {
+        int iMid = (iLow+iHigh)/2;
+        if(history.at(iMid).micros > t) iHigh = iMid;
+        else iLow = iMid+1;
+    }
+    const OrientationSample& before = history.at(iHigh-1);
+    const OrientationSample& after  = history.at(iHigh);
+    float f = float(double(t-before.micros)/double(after.micros-before.micros));
+    rotation    = QQuaternion::slerp(before.rotation, after.rotation, f);
+    shownMicros = t;
+}
+
+
+void
+GLWidget::drawLatency(quint64 now) {
+    if(history.isEmpty()) return;
+    QPainter painter(this);
+    painter.setPen(Qt::white);
+    painter.drawText(8, height()-8,
+                     QString("Playout %1 ms  Shown %2 ms behind")
+                     .arg(playoutDelayUs/1000)
+                     .arg(now > shownMicros ? (now-shownMicros)*1.0e-3 : 0.0, 0, 'f', 1));
+    painter.end();
 }
 
 
@@ -102,6 +185,11 @@ GLWidget::initializeGL() {
     // Enable back face culling
     glEnable(GL_CULL_FACE);
     geometries = new GeometryEngine;
+    if(!sMeshFile.isEmpty()) {
+        QString sReport;
+        geometries->loadMesh(sMeshFile, &sReport);
+        emit meshLoaded(sReport);
+    }
 }
 
 
@@ -151,6 +239,12 @@ GLWidget::resizeGL(int w, int h) {
 
 void
 GLWidget::paintGL() {
+    quint64 now = micros();
+    playout(now);
+    // The latency overlay QPainter leaves its own state behind
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
+    program.bind();
     // Clear color and depth buffer
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     texture->bind();
@@ -163,5 +257,11 @@ GLWidget::paintGL() {
     // Use texture unit 0 which contains cube.png
     program.setUniformValue("texture", 0);
     // Draw cube geometry
-    geometries->drawCubeGeometry(&program);
+    geometries->drawGeometry(&program);
+    program.release();
+    drawLatency(now);
+    // Samples still waiting for their playout time: the next frame is
+    // asked to the owner's repaint pacing, not forced from here
+    if(!history.isEmpty() && shownMicros < history.last().micros)
+        emit playoutPending();
 }
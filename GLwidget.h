@@ -62,6 +62,8 @@
 #include <QOpenGLShaderProgram>
 #include <QOpenGLTexture>
 
+#include "ringbuffer.h"
+
 
 QT_FORWARD_DECLARE_CLASS(GeometryEngine)
 
@@ -73,7 +75,14 @@ class GLWidget : public QOpenGLWidget, protected QOpenGLFunctions
 public:
     explicit GLWidget(QWidget *parent = 0);
     ~GLWidget();
-    void setRotation(float q0, float q1, float q2, float q3);
+    void addRotation(quint64 sampleMicros, float q0, float q1, float q2, float q3);
+    void setPlayoutDelay(int msDelay);
+    int  playoutDelay() const;
+    void setMeshFile(QString sFileName);
+
+signals:
+    void meshLoaded(QString sReport);
+    void playoutPending(); // Another frame is needed to reach the samples
 
 protected:
     void initializeGL() override;
@@ -85,6 +94,8 @@ protected:
 
     void initShaders();
     void initTextures();
+    void playout(quint64 now);
+    void drawLatency(quint64 now);
 
 private:
     QOpenGLShaderProgram program;
@@ -94,6 +105,16 @@ private:
 
     QMatrix4x4 projection;
     QQuaternion rotation;
+
+    // Orientation history, played out playoutDelayUs behind the clock
+    struct OrientationSample {
+        quint64     micros;
+        QQuaternion rotation;
+    };
+    RingBuffer<OrientationSample> history;
+    quint64 playoutDelayUs;
+    quint64 shownMicros; // Time of the orientation painted
+    QString sMeshFile;   // Empty: the textured cube
 };
 
 #endif // GLWIDGET_H
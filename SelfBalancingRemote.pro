@@ -16,12 +16,26 @@ SOURCES += \
     DataSetProperties.cpp \
     GLwidget.cpp \
     axesdialog.cpp \
+    commandscheduler.cpp \
     datastream2d.cpp \
     geometryengine.cpp \
+    latencydialog.cpp \
+    latencyhistogram.cpp \
+    linkstatistics.cpp \
     main.cpp \
     mainwidget.cpp \
+    meshloader.cpp \
+    minmaxpyramid.cpp \
+    networkworker.cpp \
     plot2d.cpp \
+    plotgllayer.cpp \
+    plottransform.cpp \
     plotpropertiesdlg.cpp \
+    repaintscheduler.cpp \
+    streamframer.cpp \
+    telemetryprotocol.cpp \
+    telemetryrecorder.cpp \
+    telemetryreplay.cpp \
     utilities.cpp
 
 HEADERS += \
@@ -30,11 +44,28 @@ HEADERS += \
     DataSetProperties.h \
     GLwidget.h \
     axesdialog.h \
+    commandscheduler.h \
     datastream2d.h \
     geometryengine.h \
+    latencydialog.h \
+    latencyhistogram.h \
+    linkstatistics.h \
     mainwidget.h \
+    meshloader.h \
+    minmaxpyramid.h \
+    networkworker.h \
     plot2d.h \
+    plotgllayer.h \
+    plottransform.h \
     plotpropertiesdlg.h \
+    repaintscheduler.h \
+    ringbuffer.h \
+    slidingextremes.h \
+    spscqueue.h \
+    streamframer.h \
+    telemetryprotocol.h \
+    telemetryrecorder.h \
+    telemetryreplay.h \
     utilities.h
 
 
@@ -51,6 +82,8 @@ DISTFILES += \
     cube.png \
     fshader.glsl \
     plot.png \
+    plotfshader.glsl \
+    plotvshader.glsl \
     vshader.glsl
 
 RESOURCES += \
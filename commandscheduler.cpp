@@ -0,0 +1,115 @@
+/*
+ *
+Copyright (C) 2016  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include "commandscheduler.h"
+
+
+CommandScheduler::CommandScheduler()
+    : nCoalesced(0)
+{
+}
+
+
+void
+CommandScheduler::clear() {
+    urgent.clear();
+    normal.clear();
+}
+
+
+// The order letter, after any leading blank
+char
+CommandScheduler::kindOf(const QByteArray& order) {
+    for(int i=0; i<order.size(); i++)
+        if(order.at(i) != ' ') return order.at(i);
+    return 0;
+}
+
+
+OrderKind
+CommandScheduler::orderKind(const QByteArray& order) {
+    switch(kindOf(order)) {
+    case 'H': return orderStop;
+    case 'K': return orderKill;
+    case 'M': return orderMove;
+    case 'P': return orderPid;
+    default:  return orderOther;
+    }
+}
+
+
+int
+CommandScheduler::remove(QList<Order>* pQueue, char kind) {
+    int nRemoved = 0;
+    for(int i=pQueue->count()-1; i>=0; i--) {
+        if(kindOf(pQueue->at(i).order) == kind) {
+            pQueue->removeAt(i);
+            nRemoved++;
+        }
+    }
+    return nRemoved;
+}
+
+
+void
+CommandScheduler::enqueue(const QByteArray& order, quint64 queuedMicros) {
+    Order newOrder;
+    newOrder.order        = order;
+    newOrder.queuedMicros = queuedMicros;
+    char kind = kindOf(order);
+    if(kind == 'H' || kind == 'K') {
+        if(kind == 'H')
+            nCoalesced += quint64(remove(&normal, 'M'));
+        // The newer order is queued behind the ones arrived meanwhile
+        nCoalesced += quint64(remove(&urgent, kind));
+        urgent.append(newOrder);
+        return;
+    }
+    if(kind == 'M' || kind == 'P')
+        nCoalesced += quint64(remove(&normal, kind));
+    normal.append(newOrder);
+}
+
+
+bool
+CommandScheduler::next(QByteArray* pOrder, quint64* pQueuedMicros) {
+    QList<Order>* pQueue = !urgent.isEmpty() ? &urgent : &normal;
+    if(pQueue->isEmpty()) return false;
+    Order first = pQueue->takeFirst();
+    *pOrder        = first.order;
+    *pQueuedMicros = first.queuedMicros;
+    return true;
+}
+
+
+bool
+CommandScheduler::isEmpty() const {
+    return urgent.isEmpty() && normal.isEmpty();
+}
+
+
+int
+CommandScheduler::count() const {
+    return urgent.count() + normal.count();
+}
+
+
+quint64
+CommandScheduler::coalesced() const {
+    return nCoalesced;
+}
@@ -0,0 +1,76 @@
+/*
+ *
+Copyright (C) 2016  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+
+#include "latencyhistogram.h"
+
+
+enum OrderKind {
+    orderStop,  // 'H'
+    orderKill,  // 'K'
+    orderMove,  // 'M'
+    orderPid,   // 'P'
+    orderOther,
+    nOrderKinds
+};
+
+
+struct OrderStats
+{
+    quint64 nSent;
+    quint64 nCoalesced;
+    LatencyHistogram latency[nOrderKinds]; // Queued by the GUI to written (us)
+};
+
+
+// Outbound orders waiting for the TCP socket. The Stop ('H') and Kill
+// ('K') orders jump ahead of everything; a Move ('M') or PID ('P')
+// order drops the one of the same kind still waiting (the newest value
+// wins), and a Stop drops the waiting Move. Apart from the orders
+// dropped, every queue keeps the order of arrival: M1, S, M2 are sent
+// as S, M2.
+class CommandScheduler
+{
+public:
+    CommandScheduler();
+
+    void clear(); // The coalesced count is kept
+    void enqueue(const QByteArray& order, quint64 queuedMicros);
+    bool next(QByteArray* pOrder, quint64* pQueuedMicros);
+    bool isEmpty() const;
+    int  count() const;
+    quint64 coalesced() const;
+    static OrderKind orderKind(const QByteArray& order);
+
+protected:
+    struct Order {
+        QByteArray order;
+        quint64    queuedMicros;
+    };
+    static char kindOf(const QByteArray& order);
+    int  remove(QList<Order>* pQueue, char kind);
+
+protected:
+    QList<Order> urgent;  // 'H' and 'K'
+    QList<Order> normal;
+    quint64      nCoalesced;
+};
@@ -17,7 +17,6 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 *
 */
 #include "datastream2d.h"
-#include <float.h>
 
 DataStream2D::DataStream2D(int Id, int PenWidth, QColor Color, int Symbol, QString Title)
 {
@@ -32,6 +31,13 @@ DataStream2D::DataStream2D(int Id, int PenWidth, QColor Color, int Symbol, QStri
     isShown         = false;
     bShowCurveTitle = false;
     maxPoints = 100;
+    nTotalPoints = 0;
+    nDescents = 0;
+    m_pointArrayX.setCapacity(maxPoints);
+    m_pointArrayY.setCapacity(maxPoints);
+    xExtremes.setCapacity(maxPoints);
+    yExtremes.setCapacity(maxPoints);
+    lod.setCapacity(maxPoints);
 }
 
 
@@ -42,6 +48,13 @@ DataStream2D::DataStream2D(DataSetProperties myProperties) {
     isShown         = false;
     bShowCurveTitle = false;
     maxPoints = 100;
+    nTotalPoints = 0;
+    nDescents = 0;
+    m_pointArrayX.setCapacity(maxPoints);
+    m_pointArrayY.setCapacity(maxPoints);
+    xExtremes.setCapacity(maxPoints);
+    yExtremes.setCapacity(maxPoints);
+    lod.setCapacity(maxPoints);
 }
 
 
@@ -57,34 +70,190 @@ DataStream2D::SetShow(bool show) {
 
 void
 DataStream2D::AddPoint(double x, double y) {
+    // Keep track of the x ordering of the points in the window
+    if(m_pointArrayX.capacity() > 1) {
+        if(m_pointArrayX.isFull() && m_pointArrayX.at(1) < m_pointArrayX.at(0))
+            nDescents--;
+        if(!m_pointArrayX.isEmpty() && x < m_pointArrayX.last())
+            nDescents++;
+    }
+    // A full buffer overwrites its oldest point in place
     m_pointArrayX.append(x);
     m_pointArrayY.append(y);
-    if(m_pointArrayX.count() == 1) {
-        minx = x-DBL_MIN;
-        maxx = x+DBL_MIN;
-        miny = y-DBL_MIN;
-        maxy = y+DBL_MIN;
+    quint64 seq = nTotalPoints++;
+    quint64 oldestSeq = nTotalPoints-quint64(m_pointArrayX.count());
+    xExtremes.evict(oldestSeq);
+    yExtremes.evict(oldestSeq);
+    lod.evict(oldestSeq);
+    xExtremes.append(seq, x);
+    yExtremes.append(seq, y);
+    lod.append(seq, x, y);
+    UpdateLimits();
+}
+
+
+// Bulk version of AddPoint(): the points are copied in the buffer with
+// at most two block copies and the limits are updated only once.
+void
+DataStream2D::AddPoints(const double* x, const double* y, int n) {
+    int iCapacity = m_pointArrayX.capacity();
+    if(n <= 0 || iCapacity == 0) return;
+    if(n >= iCapacity) {
+        // Only the newest points fit: restart the window with them
+        nTotalPoints += quint64(n-iCapacity);
+        x += n-iCapacity;
+        y += n-iCapacity;
+        n  = iCapacity;
+        RemoveAllPoints();
     }
-    if(m_pointArrayX.count() > maxPoints) {
-        m_pointArrayX.removeFirst();
-        m_pointArrayY.removeFirst();
-        minx = x-DBL_MIN;
-        maxx = x+DBL_MIN;
-        miny = y-DBL_MIN;
-        maxy = y+DBL_MIN;
-        for(int i=0; i<m_pointArrayX.count(); i++) {
-            if(m_pointArrayX.at(i) < minx) minx = m_pointArrayX.at(i);
-            if(m_pointArrayX.at(i) > maxx) maxx = m_pointArrayX.at(i);
-            if(m_pointArrayY.at(i) < miny) miny = m_pointArrayY.at(i);
-            if(m_pointArrayY.at(i) > maxy) maxy = m_pointArrayY.at(i);
+    if(iCapacity > 1) {
+        int nEvicted = m_pointArrayX.count()+n-iCapacity;
+        for(int i=0; i<nEvicted; i++) {
+            if(m_pointArrayX.at(i+1) < m_pointArrayX.at(i)) nDescents--;
+        }
+        if(!m_pointArrayX.isEmpty() && x[0] < m_pointArrayX.last())
+            nDescents++;
+        for(int i=1; i<n; i++) {
+            if(x[i] < x[i-1]) nDescents++;
         }
     }
-    else {
-        minx = minx < x ? minx : x-DBL_MIN;
-        maxx = maxx > x ? maxx : x+DBL_MIN;
-        miny = miny < y ? miny : y-DBL_MIN;
-        maxy = maxy > y ? maxy : y+DBL_MIN;
+    m_pointArrayX.append(x, n);
+    m_pointArrayY.append(y, n);
+    quint64 seq = nTotalPoints;
+    nTotalPoints += quint64(n);
+    quint64 oldestSeq = nTotalPoints-quint64(m_pointArrayX.count());
+    xExtremes.evict(oldestSeq);
+    yExtremes.evict(oldestSeq);
+    lod.evict(oldestSeq);
+    for(int i=0; i<n; i++) {
+        xExtremes.append(seq+quint64(i), x[i]);
+        yExtremes.append(seq+quint64(i), y[i]);
+        lod.append(seq+quint64(i), x[i], y[i]);
+    }
+    UpdateLimits();
+}
+
+
+void
+DataStream2D::UpdateLimits() {
+    if(xExtremes.isEmpty()) return;
+    minx = xExtremes.min();
+    maxx = xExtremes.max();
+    miny = yExtremes.min();
+    maxy = yExtremes.max();
+}
+
+
+quint64
+DataStream2D::GetTotalPoints() {
+    return nTotalPoints;
+}
+
+
+bool
+DataStream2D::IsSortedX() {
+    return nDescents == 0;
+}
+
+
+int
+DataStream2D::GetLodLevel(double maxSamplesPerBucket) {
+    return lod.levelFor(maxSamplesPerBucket);
+}
+
+
+// Appends to (x, y) a decimated polyline of the points [iFirst, iLast]
+// built from the buckets of the given level (raw points if level < 0).
+void
+DataStream2D::GetLodPoints(int level, int iFirst, int iLast, QVector<double>& x, QVector<double>& y) {
+    quint64 oldestSeq = nTotalPoints-quint64(m_pointArrayX.count());
+    CollectLod(level, oldestSeq+quint64(iFirst), oldestSeq+quint64(iLast)+1, x, y);
+}
+
+
+// Index of the first point with X >= x (count() if none).
+// Valid only when IsSortedX().
+int
+DataStream2D::LowerBoundX(double x) {
+    int iLow  = 0;
+    int iHigh = m_pointArrayX.count();
+    while(iLow < iHigh) {
+        int iMid = iLow + (iHigh-iLow)/2;
+        if(m_pointArrayX.at(iMid) < x) iLow = iMid+1;
+        else iHigh = iMid;
+    }
+    return iLow;
+}
+
+
+// Index of the first point with X > x (count() if none).
+// Valid only when IsSortedX().
+int
+DataStream2D::UpperBoundX(double x) {
+    int iLow  = 0;
+    int iHigh = m_pointArrayX.count();
+    while(iLow < iHigh) {
+        int iMid = iLow + (iHigh-iLow)/2;
+        if(m_pointArrayX.at(iMid) <= x) iLow = iMid+1;
+        else iHigh = iMid;
     }
+    return iLow;
+}
+
+
+// The buckets of a level are contiguous in sequence: the parts of the
+// range they do not fully cover are filled from the finer levels.
+void
+DataStream2D::CollectLod(int level, quint64 fromSeq, quint64 toSeq,
+                         QVector<double>& x, QVector<double>& y)
+{
+    if(fromSeq >= toSeq) return;
+    if(level < 0) {
+        int i0 = int(fromSeq-(nTotalPoints-quint64(m_pointArrayX.count())));
+        int n  = int(toSeq-fromSeq);
+        int iPos = x.count();
+        x.resize(iPos+n);
+        y.resize(iPos+n);
+        m_pointArrayX.copyTo(i0, n, x.data()+iPos);
+        m_pointArrayY.copyTo(i0, n, y.data()+iPos);
+        return;
+    }
+    const RingBuffer<LodBucket>& buckets = lod.buckets(level);
+    quint64 size = quint64(MinMaxPyramid::bucketSize(level));
+    int iFirst = 0;
+    int iLast  = -1;
+    if(!buckets.isEmpty()) {
+        quint64 seq0 = buckets.first().firstSeq;
+        if(fromSeq > seq0)
+            iFirst = int((fromSeq-seq0+size-1) / size);
+        if(toSeq >= seq0+size)
+            iLast = qMin(int((toSeq-seq0)/size)-1, buckets.count()-1);
+    }
+    if(iFirst > iLast) {
+        CollectLod(level-1, fromSeq, toSeq, x, y);
+        return;
+    }
+    CollectLod(level-1, fromSeq, buckets.at(iFirst).firstSeq, x, y);
+    for(int i=iFirst; i<=iLast; i++) {
+        const LodBucket& bucket = buckets.at(i);
+        x.append(bucket.xFirst);
+        y.append(bucket.yFirst);
+        if(bucket.xMin <= bucket.xMax) {
+            x.append(bucket.xMin);
+            y.append(bucket.yMin);
+            x.append(bucket.xMax);
+            y.append(bucket.yMax);
+        }
+        else {
+            x.append(bucket.xMax);
+            y.append(bucket.yMax);
+            x.append(bucket.xMin);
+            y.append(bucket.yMin);
+        }
+        x.append(bucket.xLast);
+        y.append(bucket.yLast);
+    }
+    CollectLod(level-1, buckets.at(iLast).firstSeq+size, toSeq, x, y);
 }
 
 
@@ -104,6 +273,10 @@ void
 DataStream2D::RemoveAllPoints() {
     m_pointArrayX.clear();
     m_pointArrayY.clear();
+    xExtremes.clear();
+    yExtremes.clear();
+    lod.clear();
+    nDescents = 0;
 }
 
 
@@ -140,7 +313,23 @@ DataStream2D::GetTitle() {
 
 void
 DataStream2D::setMaxPoints(int nPoints) {
+    if(nPoints == maxPoints) return;
     maxPoints = nPoints;
+    // Only the newest points survive a shrink
+    m_pointArrayX.setCapacity(maxPoints);
+    m_pointArrayY.setCapacity(maxPoints);
+    quint64 oldestSeq = nTotalPoints-quint64(m_pointArrayX.count());
+    xExtremes.evict(oldestSeq);
+    yExtremes.evict(oldestSeq);
+    lod.evict(oldestSeq);
+    xExtremes.setCapacity(maxPoints);
+    yExtremes.setCapacity(maxPoints);
+    lod.setCapacity(maxPoints);
+    nDescents = 0;
+    for(int i=1; i<m_pointArrayX.count(); i++) {
+        if(m_pointArrayX.at(i) < m_pointArrayX.at(i-1)) nDescents++;
+    }
+    UpdateLimits();
 }
 
 
@@ -18,10 +18,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 #pragma once
 
-#include <QVector>
 #include <QColor>
+#include <QVector>
 
 #include "DataSetProperties.h"
+#include "ringbuffer.h"
+#include "slidingextremes.h"
+#include "minmaxpyramid.h"
 
 class DataStream2D
 {
@@ -33,6 +36,7 @@ public:
     void setMaxPoints(int nPoints);
     int  getMaxPoints();
     void AddPoint(double pointX, double pointY);
+    void AddPoints(const double* pointsX, const double* pointsY, int nPoints);
     void RemoveAllPoints();
     int  GetId();
     QString GetTitle();
@@ -42,11 +46,17 @@ public:
     void SetShowTitle(bool show);
     void SetTitle(QString myTitle);
     void SetShow(bool);
+    quint64 GetTotalPoints();
+    bool IsSortedX();
+    int  GetLodLevel(double maxSamplesPerBucket);
+    void GetLodPoints(int level, int iFirst, int iLast, QVector<double>& x, QVector<double>& y);
+    int  LowerBoundX(double x);
+    int  UpperBoundX(double x);
 
  // Attributes
  public:
-    QVector<double> m_pointArrayX;
-    QVector<double> m_pointArrayY;
+    RingBuffer<double> m_pointArrayX;
+    RingBuffer<double> m_pointArrayY;
     double minx;
     double maxx;
     double miny;
@@ -54,7 +64,17 @@ public:
     bool bShowCurveTitle;
     bool isShown;
 
+ protected:
+    void UpdateLimits();
+    void CollectLod(int level, quint64 fromSeq, quint64 toSeq,
+                    QVector<double>& x, QVector<double>& y);
+
  protected:
     DataSetProperties Properties;
     int maxPoints;
+    quint64 nTotalPoints; // Points ever added: sequence of the next one
+    SlidingExtremes xExtremes;
+    SlidingExtremes yExtremes;
+    MinMaxPyramid lod;
+    int nDescents; // Consecutive pairs in the window with decreasing x
 };
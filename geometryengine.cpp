@@ -49,9 +49,12 @@
 ****************************************************************************/
 
 #include "geometryengine.h"
+#include "meshloader.h"
 
 #include <QVector2D>
 #include <QVector3D>
+#include <QOpenGLContext>
+#include <QElapsedTimer>
 
 struct VertexData
 {
@@ -59,9 +62,15 @@ struct VertexData
     QVector2D texCoord;
 };
 
+// The meshes share the attribute layout of the cube
+Q_STATIC_ASSERT(sizeof(VertexData) == sizeof(MeshVertex));
+
 
 GeometryEngine::GeometryEngine()
     : indexBuf(QOpenGLBuffer::IndexBuffer)
+    , primitive(GL_TRIANGLE_STRIP)
+    , nIndices(0)
+    , indexType(GL_UNSIGNED_SHORT)
 {
     initializeOpenGLFunctions();
 
@@ -146,11 +155,48 @@ GeometryEngine::initCubeGeometry() {
     // Transfer index data to VBO 1
     indexBuf.bind();
     indexBuf.allocate(indices, 34 * sizeof(GLushort));
+    primitive = GL_TRIANGLE_STRIP;
+    nIndices  = 34;
+    indexType = GL_UNSIGNED_SHORT;
+}
+
+
+// Replaces the cube with an OBJ or STL model. The converted model is
+// uploaded straight from the mapped cache (see MeshLoader); on failure
+// the current geometry is kept.
+bool
+GeometryEngine::loadMesh(QString sFileName, QString* pReport) {
+    QElapsedTimer timer;
+    timer.start();
+    MeshLoader loader;
+    if(!loader.load(sFileName)) {
+        *pReport = loader.errorString();
+        return false;
+    }
+    // 32 bit indices are an extension on OpenGL ES 2.0
+    QOpenGLContext* pContext = QOpenGLContext::currentContext();
+    if(loader.indexSize() == 4 && pContext && pContext->isOpenGLES() &&
+       !pContext->hasExtension("GL_OES_element_index_uint"))
+    {
+        *pReport = QString("%1: too many vertices for this OpenGL").arg(sFileName);
+        return false;
+    }
+    arrayBuf.bind();
+    arrayBuf.allocate(loader.vertices(), loader.vertexCount() * int(sizeof(MeshVertex)));
+    indexBuf.bind();
+    indexBuf.allocate(loader.indices(), loader.indexCount() * loader.indexSize());
+    primitive = GL_TRIANGLES;
+    nIndices  = loader.indexCount();
+    indexType = loader.indexSize() == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    *pReport = QString("%1 (loaded and uploaded in %2 ms)")
+               .arg(loader.report())
+               .arg(timer.nsecsElapsed()*1.0e-6, 0, 'f', 1);
+    return true;
 }
 
 
 void
-GeometryEngine::drawCubeGeometry(QOpenGLShaderProgram *program) {
+GeometryEngine::drawGeometry(QOpenGLShaderProgram *program) {
     // Tell OpenGL which VBOs to use
     arrayBuf.bind();
     indexBuf.bind();
@@ -171,6 +217,6 @@ GeometryEngine::drawCubeGeometry(QOpenGLShaderProgram *program) {
     program->enableAttributeArray(texcoordLocation);
     program->setAttributeBuffer(texcoordLocation, GL_FLOAT, offset, 2, sizeof(VertexData));
 
-    // Draw cube geometry using indices from VBO 1
-    glDrawElements(GL_TRIANGLE_STRIP, 34, GL_UNSIGNED_SHORT, 0);
+    // Draw cube (or mesh) geometry using indices from VBO 1
+    glDrawElements(primitive, nIndices, indexType, 0);
 }
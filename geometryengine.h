@@ -54,6 +54,7 @@
 #include <QOpenGLFunctions>
 #include <QOpenGLShaderProgram>
 #include <QOpenGLBuffer>
+#include <QString>
 
 class GeometryEngine : protected QOpenGLFunctions
 {
@@ -61,13 +62,17 @@ public:
     GeometryEngine();
     virtual ~GeometryEngine();
 
-    void drawCubeGeometry(QOpenGLShaderProgram *program);
+    bool loadMesh(QString sFileName, QString* pReport);
+    void drawGeometry(QOpenGLShaderProgram *program);
 
 private:
     void initCubeGeometry();
 
     QOpenGLBuffer arrayBuf;
     QOpenGLBuffer indexBuf;
+    GLenum  primitive;
+    GLsizei nIndices;
+    GLenum  indexType;
 };
 
 #endif // GEOMETRYENGINE_H
@@ -0,0 +1,127 @@
+/*
+ *
+Copyright (C) 2016  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include "latencydialog.h"
+
+
+#include <QPushButton>
+#include <QGridLayout>
+#include <QLabel>
+#include <QFile>
+#include <QTextStream>
+#include <QFileDialog>
+#include <QDateTime>
+
+
+static const char* stageName[nLatencyStages] = {
+    "Parse", "Hand-off", "Insert", "Display", "Round trip",
+    "Send Stop", "Send Kill", "Send Move", "Send PID", "Send other"
+};
+
+
+LatencyDialog::LatencyDialog(LatencyHistogram* pHistograms, QWidget *parent)
+    : QDialog(parent)
+    , pLatency(pHistograms)
+{
+    setWindowTitle("Telemetry Latency");
+    QGridLayout *pLayout = new QGridLayout();
+    const char* header[6] = { "Stage", "Count", "p50 (ms)", "p99 (ms)", "p99.9 (ms)", "Max (ms)" };
+    for(int iCol=0; iCol<6; iCol++)
+        pLayout->addWidget(new QLabel(header[iCol]), 0, iCol, 1, 1);
+    for(int iStage=0; iStage<nLatencyStages; iStage++) {
+        pLayout->addWidget(new QLabel(stageName[iStage]), iStage+1, 0, 1, 1);
+        for(int iCol=0; iCol<5; iCol++) {
+            pLabelValue[iStage][iCol] = new QLabel();
+            pLabelValue[iStage][iCol]->setAlignment(Qt::AlignRight);
+            pLayout->addWidget(pLabelValue[iStage][iCol], iStage+1, iCol+1, 1, 1);
+        }
+    }
+
+    pButtonReset = new QPushButton("Reset");
+    pButtonSave  = new QPushButton("Save...");
+    pButtonClose = new QPushButton("Close");
+    pLayout->addWidget(pButtonReset, nLatencyStages+1, 3, 1, 1);
+    pLayout->addWidget(pButtonSave,  nLatencyStages+1, 4, 1, 1);
+    pLayout->addWidget(pButtonClose, nLatencyStages+1, 5, 1, 1);
+
+    connect(pButtonReset, SIGNAL(clicked()),
+            this, SLOT(onResetPushed()));
+    connect(pButtonSave, SIGNAL(clicked()),
+            this, SLOT(onSavePushed()));
+    connect(pButtonClose, SIGNAL(clicked()),
+            this, SLOT(accept()));
+    connect(&refreshTimer, SIGNAL(timeout()),
+            this, SLOT(onRefresh()));
+
+    setLayout(pLayout);
+    onRefresh();
+    refreshTimer.start(500);
+}
+
+
+LatencyDialog::~LatencyDialog() {
+}
+
+
+void
+LatencyDialog::onRefresh() {
+    for(int iStage=0; iStage<nLatencyStages; iStage++) {
+        const LatencyHistogram& h = pLatency[iStage];
+        pLabelValue[iStage][0]->setText(QString::number(h.count()));
+        pLabelValue[iStage][1]->setText(QString::number(h.percentile(0.5)*1.0e-3,   'f', 3));
+        pLabelValue[iStage][2]->setText(QString::number(h.percentile(0.99)*1.0e-3,  'f', 3));
+        pLabelValue[iStage][3]->setText(QString::number(h.percentile(0.999)*1.0e-3, 'f', 3));
+        pLabelValue[iStage][4]->setText(QString::number(h.maxValue()*1.0e-3,        'f', 3));
+    }
+}
+
+
+void
+LatencyDialog::onResetPushed() {
+    for(int iStage=0; iStage<nLatencyStages; iStage++)
+        pLatency[iStage].clear();
+    emit resetRequested();
+    onRefresh();
+}
+
+
+// The non empty buckets of every stage, to be compared between runs
+void
+LatencyDialog::onSavePushed() {
+    QString sFileName = QFileDialog::getSaveFileName(this, "Save Latency Histograms",
+                                                     QString(), "Text (*.txt)");
+    if(sFileName.isEmpty()) return;
+    QFile file(sFileName);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Text)) return;
+    QTextStream out(&file);
+    out << "# Telemetry latency " << QDateTime::currentDateTime().toString(Qt::ISODate) << "\n";
+    for(int iStage=0; iStage<nLatencyStages; iStage++) {
+        const LatencyHistogram& h = pLatency[iStage];
+        out << "# " << stageName[iStage]
+            << " count=" << h.count()
+            << " mean=" << h.mean()
+            << " p50=" << h.percentile(0.5)
+            << " p99=" << h.percentile(0.99)
+            << " p999=" << h.percentile(0.999)
+            << " max=" << h.maxValue() << "\n";
+        for(int i=0; i<h.nBuckets(); i++) {
+            if(h.bucketCount(i) == 0) continue;
+            out << iStage << "\t" << LatencyHistogram::bucketValue(i) << "\t" << h.bucketCount(i) << "\n";
+        }
+    }
+}
@@ -0,0 +1,56 @@
+/*
+ *
+Copyright (C) 2016  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QDialog>
+#include <QTimer>
+
+#include "latencyhistogram.h"
+
+
+QT_FORWARD_DECLARE_CLASS(QLabel)
+QT_FORWARD_DECLARE_CLASS(QPushButton)
+
+
+// Shows the per stage latency percentiles of the telemetry path.
+// The histograms are owned by the caller and only read here (GUI thread).
+class LatencyDialog : public QDialog
+{
+  Q_OBJECT
+
+public:
+    explicit LatencyDialog(LatencyHistogram* pHistograms, QWidget *parent = Q_NULLPTR);
+    ~LatencyDialog();
+
+signals:
+    void resetRequested(); // For the histograms kept elsewhere
+
+private slots:
+    void onRefresh();
+    void onResetPushed();
+    void onSavePushed();
+
+private:
+    LatencyHistogram* pLatency;
+    QLabel*      pLabelValue[nLatencyStages][5];
+    QPushButton* pButtonReset;
+    QPushButton* pButtonSave;
+    QPushButton* pButtonClose;
+    QTimer       refreshTimer;
+};
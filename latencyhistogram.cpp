@@ -0,0 +1,116 @@
+/*
+ *
+Copyright (C) 2016  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include "latencyhistogram.h"
+
+#include <QtAlgorithms>
+#include <string.h>
+
+
+LatencyHistogram::LatencyHistogram() {
+    clear();
+}
+
+
+void
+LatencyHistogram::clear() {
+    memset(counts, 0, sizeof(counts));
+    nTotal  = 0;
+    maximum = 0;
+    sum     = 0.0;
+}
+
+
+// Values below subBuckets have their own bucket; the others are
+// (shift+1)*subBuckets + (value >> shift) - subBuckets, where shift
+// leaves subBucketBits+1 significant bits.
+int
+LatencyHistogram::indexOf(quint64 value) {
+    if(value < quint64(subBuckets)) return int(value);
+    int iMsb = 63-int(qCountLeadingZeroBits(value));
+    int iShift = iMsb-subBucketBits;
+    if(iShift > maxShift) return (maxShift+2)*subBuckets-1;
+    return (iShift+1)*subBuckets + int(value >> iShift) - subBuckets;
+}
+
+
+// Lowest value of a bucket
+quint64
+LatencyHistogram::bucketValue(int iBucket) {
+    if(iBucket < subBuckets) return quint64(iBucket);
+    int iShift = iBucket/subBuckets-1;
+    return quint64(iBucket%subBuckets + subBuckets) << iShift;
+}
+
+
+void
+LatencyHistogram::record(quint64 value) {
+    counts[indexOf(value)]++;
+    nTotal++;
+    sum += double(value);
+    if(value > maximum) maximum = value;
+}
+
+
+quint64
+LatencyHistogram::count() const {
+    return nTotal;
+}
+
+
+quint64
+LatencyHistogram::maxValue() const {
+    return maximum;
+}
+
+
+double
+LatencyHistogram::mean() const {
+    return nTotal > 0 ? sum/double(nTotal) : 0.0;
+}
+
+
+// Value not exceeded by the fraction p (0..1) of the samples
+quint64
+LatencyHistogram::percentile(double p) const {
+    if(nTotal == 0) return 0;
+    quint64 nWanted = quint64(p*double(nTotal)+0.5);
+    if(nWanted < 1) nWanted = 1;
+    quint64 nSeen = 0;
+    for(int i=0; i<nBuckets(); i++) {
+        nSeen += counts[i];
+        if(nSeen >= nWanted) {
+            // The highest value of the bucket, but not above the maximum
+            quint64 high = (i+1 < nBuckets()) ? bucketValue(i+1)-1 : maximum;
+            return qMin(high, maximum);
+        }
+    }
+    return maximum;
+}
+
+
+int
+LatencyHistogram::nBuckets() const {
+    return (maxShift+2)*subBuckets;
+}
+
+
+quint64
+LatencyHistogram::bucketCount(int iBucket) const {
+    return counts[iBucket];
+}
@@ -0,0 +1,73 @@
+/*
+ *
+Copyright (C) 2016  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QtGlobal>
+
+
+// Stages of the telemetry path (all in us, measured from the socket read)
+enum LatencyStage {
+    latencyParse,     // Read to decoded (network thread)
+    latencyHandoff,   // Read to popped by the GUI thread
+    latencyInsert,    // Read to in the plot or in the cube
+    latencyDisplay,   // Read to painted
+    latencyRoundTrip, // Echo order to the Robot reply
+    latencySendStop,  // Order queued to written to the socket,
+    latencySendKill,  // one stage per OrderKind (see commandscheduler.h)
+    latencySendMove,
+    latencySendPid,
+    latencySendOther,
+    nLatencyStages
+};
+
+
+// HDR style histogram of latencies (us): every power of two range is
+// split in subBuckets linear buckets, so that the relative error stays
+// below 1/subBuckets (about 3%) from 1us to more than one day.
+// Recording a value is O(1) and never allocates.
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void clear();
+    void record(quint64 value);
+    quint64 count() const;
+    quint64 maxValue() const;
+    double  mean() const;
+    quint64 percentile(double p) const;
+
+    // The buckets, for the dumps
+    int nBuckets() const;
+    quint64 bucketCount(int iBucket) const;
+    static quint64 bucketValue(int iBucket);
+
+    static const int subBucketBits = 5;
+    static const int subBuckets    = 1 << subBucketBits;
+    static const int maxShift      = 32;
+
+protected:
+    static int indexOf(quint64 value);
+
+protected:
+    quint64 counts[(maxShift+2)*subBuckets];
+    quint64 nTotal;
+    quint64 maximum;
+    double  sum;
+};
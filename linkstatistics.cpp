@@ -0,0 +1,118 @@
+/*
+ *
+Copyright (C) 2016  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include "linkstatistics.h"
+
+#include <math.h>
+#include <string.h>
+
+
+double
+LinkStats::lossRate() const {
+    return nExpected > 0 ? double(nLost)/double(nExpected) : 0.0;
+}
+
+
+LinkStatistics::LinkStatistics() {
+    clear();
+}
+
+
+void
+LinkStatistics::clear() {
+    memset(&current, 0, sizeof(current));
+    memset(seen, 0, sizeof(seen));
+    bStarted          = false;
+    highestSeq        = 0;
+    lastSenderMicros  = 0;
+    lastArrivalMicros = 0;
+}
+
+
+bool
+LinkStatistics::testAndSet(quint32 sequence) {
+    quint32 iBit = sequence % windowSize;
+    quint64 mask = quint64(1) << (iBit % 64);
+    bool bSeen = (seen[iBit/64] & mask) != 0;
+    seen[iBit/64] |= mask;
+    return bSeen;
+}
+
+
+void
+LinkStatistics::clearBit(quint32 sequence) {
+    quint32 iBit = sequence % windowSize;
+    seen[iBit/64] &= ~(quint64(1) << (iBit % 64));
+}
+
+
+void
+LinkStatistics::addPacket(quint32 sequence, quint64 senderMicros, quint64 arrivalMicros) {
+    if(!bStarted) {
+        bStarted   = true;
+        highestSeq = sequence;
+        testAndSet(sequence);
+        current.nReceived = 1;
+        current.nExpected = 1;
+        lastSenderMicros  = senderMicros;
+        lastArrivalMicros = arrivalMicros;
+        return;
+    }
+    // Sequence numbers wrap around: the signed difference tells the order
+    qint32 delta = qint32(sequence-highestSeq);
+    if(delta > 0) {
+        // The bits of the sequence numbers leaving the window are reused
+        if(delta >= windowSize) {
+            memset(seen, 0, sizeof(seen));
+        }
+        else {
+            for(quint32 s=highestSeq+1; s!=sequence; s++)
+                clearBit(s);
+        }
+        testAndSet(sequence);
+        current.nExpected += quint64(delta);
+        current.nLost     += quint64(delta-1);
+        highestSeq = sequence;
+    }
+    else if(-delta >= windowSize) {
+        return; // Too old to tell: ignored
+    }
+    else if(testAndSet(sequence)) {
+        current.nDuplicates++;
+        return;
+    }
+    else {
+        // Late packet: it had been counted as lost
+        current.nReordered++;
+        if(current.nLost > 0) current.nLost--;
+    }
+    current.nReceived++;
+
+    // RFC 3550: D = (Rj-Ri)-(Sj-Si), J += (|D|-J)/16
+    double d = (double(arrivalMicros)-double(lastArrivalMicros)) -
+               (double(senderMicros)-double(lastSenderMicros));
+    current.jitter += (fabs(d)-current.jitter)/16.0;
+    lastSenderMicros  = senderMicros;
+    lastArrivalMicros = arrivalMicros;
+}
+
+
+LinkStats
+LinkStatistics::stats() const {
+    return current;
+}
@@ -0,0 +1,61 @@
+/*
+ *
+Copyright (C) 2016  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QtGlobal>
+
+
+struct LinkStats
+{
+    quint64 nReceived;   // Distinct packets
+    quint64 nExpected;   // From the first to the highest sequence number
+    quint64 nLost;       // Expected but never arrived (so far)
+    quint64 nReordered;  // Arrived after a higher sequence number
+    quint64 nDuplicates;
+    double  jitter;      // Interarrival jitter (us, RFC 3550)
+    double  lossRate() const;
+};
+
+
+// Statistics of a sequence numbered packet stream, O(1) per packet.
+// The last windowSize sequence numbers are remembered in a bitmap to
+// tell the late packets from the duplicates.
+class LinkStatistics
+{
+public:
+    LinkStatistics();
+
+    void clear();
+    void addPacket(quint32 sequence, quint64 senderMicros, quint64 arrivalMicros);
+    LinkStats stats() const;
+
+    static const int windowSize = 1024;
+
+protected:
+    bool testAndSet(quint32 sequence);
+    void clearBit(quint32 sequence);
+
+protected:
+    LinkStats current;
+    bool      bStarted;
+    quint32   highestSeq;
+    quint64   lastSenderMicros;
+    quint64   lastArrivalMicros;
+    quint64   seen[windowSize/64];
+};
@@ -1,6 +1,10 @@
 #include "mainwidget.h"
 #include "plot2d.h"
 #include "GLwidget.h"
+#include "telemetryprotocol.h"
+#include "networkworker.h"
+#include "latencydialog.h"
+#include "utilities.h"
 
 #include <QDebug>
 #include <QThread>
@@ -8,17 +12,17 @@
 #include <QLineEdit>
 #include <QLabel>
 #include <QSettings>
-#include <QTcpServer>
-#include <QTcpSocket>
 #include <QHostAddress>
 #include <QNetworkInterface>
-#include <QUdpSocket>
-#include <QNetworkDatagram>
 #include <QHBoxLayout>
 #include <QVBoxLayout>
 #include <QKeyEvent>
 #include <QStatusBar>
 #include <QIcon>
+#include <QDir>
+#include <QDateTime>
+#include <QComboBox>
+#include <QFileDialog>
 
 
 //==============================================================
@@ -31,6 +35,8 @@
 //      M           Start Moving (at a given speed Left & Rigth)
 //      H           Stop Moving
 //      K           Kill Remote Program
+//      B           Ask Binary Telemetry (protocol version)
+//      E           Echo (identifier)
 //==============================================================
 
 
@@ -40,59 +46,121 @@
 //      q               Quaternion Value
 //      p               PID Values (time, input & output)
 //      c               Robot Configuration Values
+//      r               Reset
+//      b               Binary Telemetry Accepted (protocol version)
+//      e               Echo Reply (identifier)
 //==============================================================
 
 
+// Latency samples waiting for a paint (they are dropped beyond this,
+// i.e. while the window is hidden)
+#define MAX_PENDING_PAINT 65536
+
+
 MainWidget::MainWidget(QWidget *parent)
     : QWidget(parent)
-    , pUdpSocket(nullptr)
+    , pNetworkWorker(nullptr)
+    , bConnected(false)
+    , bBinaryTelemetry(true)
+    , bUdpBatchReceive(true)
     , udpPort(37755)
+    , bRecording(false)
     // Widgets
     , pGLWidget(nullptr)
     , pPlotVal(nullptr)
     // Status
     , bPIDInControl(false)
+    , maxFps(0.0)
+    , playoutDelay(50)
+    // Replay
+    , nReplayed(0)
+    , nReplayFrames(0)
+    , replayFrameTotal(0)
+    , replayFrameMax(0)
+    // Latency
+    , pingId(0)
+    , pingSent(0)
 {
     setWindowIcon(QIcon(":/10DOF.png"));
     initLayout();
     restoreSettings();
 
-    pUdpSocket = new QUdpSocket(this);
-    if(!pUdpSocket->bind(QHostAddress::Any, udpPort)) {
-        statusBar->showMessage("Unable to bind... EXITING");
-        setDisabled(true);
-    }
-
-    // Network UDP events
-    connect(pUdpSocket, SIGNAL(readyRead()),
-            this, SLOT(onReadPendingDatagrams()));
-
-    // Network TCP events
-    connect(&tcpClient, SIGNAL(connected()),
+    // Repainted at most once per frame, and only with new data
+    iCubeTarget = repaintScheduler.addTarget(pGLWidget, "update");
+    iPlotTarget = repaintScheduler.addTarget(pPlotVal, "UpdatePlot");
+    repaintScheduler.setMaxFps(maxFps);
+    pGLWidget->setPlayoutDelay(playoutDelay);
+
+    // The sockets live in their own thread: a slow paint or a modal
+    // dialog must not delay the telemetry ingest
+    qRegisterMetaType<QHostAddress>("QHostAddress");
+    pNetworkWorker = new NetworkWorker(udpPort);
+    pNetworkWorker->setBatchReceive(bUdpBatchReceive);
+    pNetworkWorker->moveToThread(&networkThread);
+    connect(&networkThread, SIGNAL(started()),
+            pNetworkWorker, SLOT(start()));
+    connect(&networkThread, SIGNAL(finished()),
+            pNetworkWorker, SLOT(deleteLater()));
+
+    // Network events
+    connect(pNetworkWorker, SIGNAL(udpBindFailed()),
+            this, SLOT(onUdpBindFailed()));
+    connect(pNetworkWorker, SIGNAL(connected()),
             this, SLOT(onServerConnected()));
-    connect(&tcpClient, SIGNAL(disconnected()),
+    connect(pNetworkWorker, SIGNAL(disconnected()),
             this, SLOT(onServerDisconnected()));
-    connect(&tcpClient, SIGNAL(readyRead()),
-            this, SLOT(onNewDataAvailable()));
-    connect(&tcpClient, SIGNAL(error(QAbstractSocket::SocketError)),
-            this, SLOT(displayError(QAbstractSocket::SocketError)));
-
-    // Timer Event for Widgets Updating
+    connect(pNetworkWorker, SIGNAL(socketError(int,QString)),
+            this, SLOT(displayError(int,QString)));
+    connect(pNetworkWorker, SIGNAL(messageReceived(QByteArray)),
+            this, SLOT(onMessageReceived(QByteArray)));
+    connect(pNetworkWorker, SIGNAL(samplesAvailable()),
+            this, SLOT(onSamplesAvailable()));
+    connect(pNetworkWorker, SIGNAL(recordingStarted(bool,QString)),
+            this, SLOT(onRecordingStarted(bool,QString)));
+    connect(pNetworkWorker, SIGNAL(recordingStopped(quint64)),
+            this, SLOT(onRecordingStopped(quint64)));
+
+    // Orders to the Robot
+    connect(this, SIGNAL(connectToRobot(QHostAddress,quint16)),
+            pNetworkWorker, SLOT(connectToRobot(QHostAddress,quint16)));
+    connect(this, SIGNAL(disconnectFromRobot()),
+            pNetworkWorker, SLOT(disconnectFromRobot()));
+    connect(this, SIGNAL(sendToRobot(QByteArray,quint64)),
+            pNetworkWorker, SLOT(send(QByteArray,quint64)));
+    connect(this, SIGNAL(startRecording(QString)),
+            pNetworkWorker, SLOT(startRecording(QString)));
+    connect(this, SIGNAL(stopRecording()),
+            pNetworkWorker, SLOT(stopRecording()));
+
+    networkThread.start();
+
+    // Timer Event for the Status Updating
     connect(&timerUpdate, SIGNAL(timeout()),
             this, SLOT(onTimeToUpdateWidgets()));
-    timerUpdate.start(100);
+    timerUpdate.start(500);
+
+    connect(&timerReplay, SIGNAL(timeout()),
+            this, SLOT(onReplayTick()));
+
+    // Round trip probe (a Robot not knowing the order ignores it),
+    // sent only while the latency dialog is open
+    connect(&timerPing, SIGNAL(timeout()),
+            this, SLOT(onTimeToPing()));
 }
 
 
 MainWidget::~MainWidget() {
+    if(networkThread.isRunning()) {
+        QMetaObject::invokeMethod(pNetworkWorker, "stop", Qt::BlockingQueuedConnection);
+        networkThread.quit();
+        networkThread.wait();
+    }
 }
 
 
 void
 MainWidget::closeEvent(QCloseEvent *event) {
     Q_UNUSED(event)
-    if(pUdpSocket)
-        delete pUdpSocket;
     saveSettings();
 }
 
@@ -110,6 +178,19 @@ void
 MainWidget::createUi() {
     buttonClose           = new QPushButton("Close",     this);
     buttonManualControl   = new QPushButton("PID Ctrl",  this);
+    buttonRecord          = new QPushButton("Record",    this);
+    buttonReplay          = new QPushButton("Replay",    this);
+    buttonLatency         = new QPushButton("Latency",   this);
+
+    comboReplaySpeed = new QComboBox(this);
+    comboReplaySpeed->addItem("1x",  1.0);
+    comboReplaySpeed->addItem("2x",  2.0);
+    comboReplaySpeed->addItem("10x", 10.0);
+    comboReplaySpeed->addItem("Max", 0.0);
+    buttonReplayBack      = new QPushButton("<< 10s",    this);
+    buttonReplayForward   = new QPushButton("10s >>",    this);
+    buttonReplayBack->setDisabled(true);
+    buttonReplayForward->setDisabled(true);
     buttonConnect         = new QPushButton("Connect",   this);
     buttonMove            = new QPushButton("Move",      this);
     buttonSetPid          = new QPushButton("Set PID",   this);
@@ -139,14 +220,36 @@ MainWidget::createUi() {
     editSetpoint->setAlignment(Qt::AlignRight);
 
     statusBar = new QStatusBar(this);
+    labelIngest = new QLabel(this);
+    labelLink   = new QLabel(this);
+    statusBar->addPermanentWidget(labelLink);
+    statusBar->addPermanentWidget(labelIngest);
 
     pGLWidget = new GLWidget(this);
     createPlot();
+    connect(pGLWidget, SIGNAL(frameSwapped()),
+            this, SLOT(onCubePainted()));
+    connect(pGLWidget, SIGNAL(playoutPending()),
+            this, SLOT(onCubePlayoutPending()));
+    connect(pGLWidget, SIGNAL(meshLoaded(QString)),
+            statusBar, SLOT(showMessage(QString)));
+    connect(pPlotVal, SIGNAL(framePainted()),
+            this, SLOT(onPlotPainted()));
 
     connect(buttonClose, SIGNAL(clicked()),
             this, SLOT(onButtonClosePushed()));
     connect(buttonManualControl, SIGNAL(clicked()),
             this, SLOT(onButtonManualPushed()));
+    connect(buttonRecord, SIGNAL(clicked()),
+            this, SLOT(onRecordPushed()));
+    connect(buttonReplay, SIGNAL(clicked()),
+            this, SLOT(onReplayPushed()));
+    connect(buttonReplayBack, SIGNAL(clicked()),
+            this, SLOT(onReplayBackPushed()));
+    connect(buttonReplayForward, SIGNAL(clicked()),
+            this, SLOT(onReplayForwardPushed()));
+    connect(buttonLatency, SIGNAL(clicked()),
+            this, SLOT(onLatencyPushed()));
     connect(buttonConnect, SIGNAL(clicked()),
             this, SLOT(onConnectToClient()));
     connect(buttonMove, SIGNAL(clicked()),
@@ -164,6 +267,14 @@ MainWidget::restoreSettings() {
     // Tcp Server
     QString sServer = settings.value("tcpServer", "raspberrypi.local").toString();
     editHostName->setText(sServer);
+    bBinaryTelemetry = settings.value("binaryTelemetry", true).toBool();
+    bUdpBatchReceive = settings.value("udpBatchReceive", true).toBool();
+    sRecordPath = settings.value("recordPath", QDir::homePath()).toString();
+    maxFps = settings.value("maxFps", 0.0).toDouble();
+    playoutDelay = settings.value("playoutDelay", 50).toInt();
+    // Robot model (OBJ or STL) instead of the cube
+    pGLWidget->setMeshFile(settings.value("robotMesh", QString()).toString());
+    pPlotVal->SetOpenGL(settings.value("plotOpenGL", false).toBool());
 }
 
 
@@ -171,6 +282,12 @@ void
 MainWidget::saveSettings() {
     QSettings settings;
     settings.setValue("tcpServer", editHostName->text());
+    settings.setValue("binaryTelemetry", bBinaryTelemetry);
+    settings.setValue("udpBatchReceive", bUdpBatchReceive);
+    settings.setValue("recordPath", sRecordPath);
+    settings.setValue("maxFps", maxFps);
+    settings.setValue("playoutDelay", playoutDelay);
+    settings.setValue("plotOpenGL", pPlotVal->IsOpenGL());
 }
 
 
@@ -242,6 +359,12 @@ MainWidget::initLayout() {
     secondButtonRow->addWidget(buttonConnect);
     secondButtonRow->addWidget(buttonClose);
     secondButtonRow->addWidget(buttonManualControl);
+    secondButtonRow->addWidget(buttonRecord);
+    secondButtonRow->addWidget(buttonReplay);
+    secondButtonRow->addWidget(buttonReplayBack);
+    secondButtonRow->addWidget(buttonReplayForward);
+    secondButtonRow->addWidget(comboReplaySpeed);
+    secondButtonRow->addWidget(buttonLatency);
 
 //    thirdButtonRow = new QHBoxLayout;
 
@@ -267,7 +390,7 @@ MainWidget::onConnectToClient() {
         editHostName->setDisabled(true);
         QHostInfo::lookupHost(editHostName->text(), this, SLOT(handleLookup(QHostInfo)));
     } else {//pButtonConnect->text() == tr("Disconnect")
-        tcpClient.close();
+        emit disconnectFromRobot();
     }
 }
 
@@ -279,7 +402,7 @@ MainWidget::handleLookup(QHostInfo hostInfo) {
         if(!hostInfo.addresses().isEmpty()) {
             serverAddress = hostInfo.addresses().at(0);
             statusBar->showMessage(QString("Connecting to: %1").arg(hostInfo.hostName()));
-            tcpClient.connectToHost(serverAddress, 43210);
+            emit connectToRobot(serverAddress, 43210);
         }
         else {
             statusBar->showMessage(QString(hostInfo.errorString()));
@@ -295,14 +418,13 @@ MainWidget::handleLookup(QHostInfo hostInfo) {
 
 
 void
-MainWidget::displayError(QAbstractSocket::SocketError socketError) {
-    if(socketError == QTcpSocket::RemoteHostClosedError) {
+MainWidget::displayError(int socketError, QString sError) {
+    // The worker has already closed the socket
+    if(socketError == QAbstractSocket::RemoteHostClosedError) {
         statusBar->showMessage(QString("The remote host has closed the connection"));
-        tcpClient.close();
         return;
     }
-    statusBar->showMessage(QString(tcpClient.errorString()));
-    tcpClient.close();
+    statusBar->showMessage(sError);
     buttonConnect->setEnabled(true);
     editHostName->setEnabled(true);
 }
@@ -311,6 +433,14 @@ MainWidget::displayError(QAbstractSocket::SocketError socketError) {
 void
 MainWidget::onServerConnected() {
     statusBar->showMessage(QString("Connected"));
+    bConnected = true;
+    pNetworkWorker->resetLinkStats();
+    if(bBinaryTelemetry) {
+        // A Robot not knowing the order simply keeps sending ASCII
+        message.clear();
+        message.append(QString("B %1#").arg(TELEMETRY_VERSION).toLatin1());
+        sendOrder(message);
+    }
     askConfiguration(); // Get Current Robot Configuration
 
     setDisableUI(false);
@@ -320,13 +450,15 @@ MainWidget::onServerConnected() {
 
     pPlotVal->ClearDataSet(4);
     pPlotVal->ClearDataSet(5);
-    timerUpdate.start(100);
+    repaintScheduler.markDirty(iPlotTarget);
 }
 
 
 void
 MainWidget::onServerDisconnected() {
-    timerUpdate.stop();
+    bConnected = false;
+    pingSent   = 0;
+    // The timer keeps draining the UDP telemetry
     setDisableUI(true);
     buttonConnect->setText("Connect");
     editHostName->setEnabled(true);
@@ -335,73 +467,235 @@ MainWidget::onServerDisconnected() {
 
 
 void
-MainWidget::onNewDataAvailable() {
-    receivedCommand += tcpClient.readAll();
-    QString sNewCommand;
-    int iPos;
-    iPos = receivedCommand.indexOf("#");
-    while(iPos != -1) {
-        sNewCommand = receivedCommand.left(iPos);
-        executeCommand(sNewCommand);
-        receivedCommand = receivedCommand.mid(iPos+1);
-        iPos = receivedCommand.indexOf("#");
-    }
+MainWidget::onUdpBindFailed() {
+    statusBar->showMessage("Unable to bind... EXITING");
+    setDisabled(true);
+}
+
+
+// Rare messages (i.e. the Robot configuration)
+void
+MainWidget::onMessageReceived(QByteArray received) {
+    TelemetryMessage command;
+    DecodeTelemetry(received.constData(), received.size(), &command);
+    if(command.type)
+        executeCommand(command);
 }
 
 
 void
-MainWidget::onReadPendingDatagrams() {
-    while(pUdpSocket->hasPendingDatagrams()) {
-        QNetworkDatagram datagram = pUdpSocket->receiveDatagram();
-        QString sReceived = QString(datagram.data());
-        QString sNewCommand;
-        int iPos;
-        iPos = sReceived.indexOf("#");
-        while(iPos != -1) {
-            sNewCommand = sReceived.left(iPos);
-            executeCommand(sNewCommand);
-            sReceived = sReceived.mid(iPos+1);
-            iPos = sReceived.indexOf("#");
+MainWidget::onSamplesAvailable() {
+    pNetworkWorker->armSamplesAvailable();
+    drainTelemetry();
+}
+
+
+// Executes the telemetry samples received so far.
+// Consecutive complete PID samples reach the plot in a single call.
+void
+MainWidget::drainTelemetry() {
+    TelemetryMessage sample;
+    while(pNetworkWorker->popSample(&sample)) {
+        // Live data are ignored while replaying
+        if(replay.isRunning()) continue;
+        if(sample.readMicros) {
+            latency[latencyParse].record(sample.parsedMicros-sample.readMicros);
+            latency[latencyHandoff].record(micros()-sample.readMicros);
         }
+        processSample(sample);
+    }
+    flushPidSamples();
+}
+
+
+void
+MainWidget::updateStatus() {
+    OrderStats sent = pNetworkWorker->orderStats();
+    for(int i=0; i<nOrderKinds; i++)
+        latency[latencySendStop+i] = sent.latency[i];
+    labelIngest->setText(QString("Queue: %1 (max %2)  Drops: %3  Orders: %4 (%5 coalesced)  FPS: %6  Skipped: %7")
+                         .arg(pNetworkWorker->queueDepth())
+                         .arg(pNetworkWorker->maxQueueDepth())
+                         .arg(pNetworkWorker->droppedSamples())
+                         .arg(sent.nSent)
+                         .arg(sent.nCoalesced)
+                         .arg(repaintScheduler.fps(), 0, 'f', 1)
+                         .arg(repaintScheduler.skippedFrames()));
+    // Only the sequence numbered datagrams give the link statistics
+    LinkStats link = pNetworkWorker->linkStats();
+    if(link.nReceived > 0) {
+        labelLink->setText(QString("Loss: %1%  Reordered: %2  Dup: %3  Jitter: %4ms")
+                           .arg(100.0*link.lossRate(), 0, 'f', 2)
+                           .arg(link.nReordered)
+                           .arg(link.nDuplicates)
+                           .arg(link.jitter*1.0e-3, 0, 'f', 2));
     }
 }
 
 
+// Live and replayed samples take this path
+void
+MainWidget::processSample(const TelemetryMessage& sample) {
+    if(sample.type == 'p' && sample.nValues == 3) {
+        pidTime.append(sample.value[0]);
+        pidInput.append(sample.value[1]);
+        pidOutput.append(sample.value[2]);
+        pidRead.append(sample.readMicros);
+        return;
+    }
+    flushPidSamples();
+    executeCommand(sample);
+    if(sample.type == 'q')
+        recordInsert(sample.readMicros, &cubePending);
+}
+
+
+void
+MainWidget::flushPidSamples() {
+    if(pidTime.isEmpty()) return;
+    pPlotVal->NewPoints(4, pidTime.constData(), pidInput.constData(), pidTime.count());
+    pPlotVal->NewPoints(5, pidTime.constData(), pidOutput.constData(), pidTime.count());
+    for(int i=0; i<pidRead.count(); i++)
+        recordInsert(pidRead.at(i), &plotPending);
+    pidTime.clear();
+    pidInput.clear();
+    pidOutput.clear();
+    pidRead.clear();
+    repaintScheduler.markDirty(iPlotTarget);
+}
+
+
+// Replayed samples have no read time and are not measured
+void
+MainWidget::recordInsert(quint64 readMicros, QVector<quint64>* pPending) {
+    if(readMicros == 0) return;
+    latency[latencyInsert].record(micros()-readMicros);
+    if(pPending->count() < MAX_PENDING_PAINT)
+        pPending->append(readMicros);
+}
+
+
+void
+MainWidget::recordDisplay(QVector<quint64>* pPending) {
+    if(pPending->isEmpty()) return;
+    quint64 now = micros();
+    for(int i=0; i<pPending->count(); i++)
+        latency[latencyDisplay].record(now-pPending->at(i));
+    pPending->clear();
+}
+
+
+void
+MainWidget::onPlotPainted() {
+    recordDisplay(&plotPending);
+}
+
+
+void
+MainWidget::onCubePainted() {
+    recordDisplay(&cubePending);
+}
+
+
+// The cube lags the samples by the playout delay: it is repainted at the
+// scheduler's pace until it has caught up with them
+void
+MainWidget::onCubePlayoutPending() {
+    repaintScheduler.markDirty(iCubeTarget);
+}
+
+
+// The Move and PID orders may be superseded by newer ones before
+// leaving (see CommandScheduler)
+void
+MainWidget::sendOrder(const QByteArray& order) {
+    emit sendToRobot(order, micros());
+}
+
+
+void
+MainWidget::onTimeToPing() {
+    if(!bConnected) return;
+    pingId++;
+    pingSent = micros();
+    message.clear();
+    message.append(QString("E %1#").arg(pingId).toLatin1());
+    sendOrder(message);
+}
+
+
+void
+MainWidget::onLatencyPushed() {
+    LatencyDialog dialog(latency, this);
+    connect(&dialog, SIGNAL(resetRequested()),
+            this, SLOT(onLatencyReset()));
+    onTimeToPing();
+    timerPing.start(1000);
+    dialog.exec();
+    timerPing.stop();
+    pingSent = 0;
+}
+
+
+// The send latency is measured in the network thread and copied from
+// there by updateStatus()
+void
+MainWidget::onLatencyReset() {
+    pNetworkWorker->resetOrderLatency();
+}
+
+
+// The samples normally arrive with samplesAvailable(): the drain here
+// is only a safety net
 void
 MainWidget::onTimeToUpdateWidgets() {
-    pGLWidget->update();
-    pPlotVal->UpdatePlot();
+    drainTelemetry();
+    updateStatus();
 }
 
 
 void
-MainWidget::executeCommand(QString command) {
-    QStringList tokens = command.split(' ');
-    tokens.removeFirst();
-    char cmd = command.at(0).toLatin1();
+MainWidget::executeCommand(const TelemetryMessage& command) {
+    char cmd = command.type;
     if(cmd == 'q') { // It is a Quaternion !
-        if(tokens.count() == 4) {
-            q0 = tokens.at(0).toDouble();
-            q1 = tokens.at(1).toDouble();
-            q2 = tokens.at(2).toDouble();
-            q3 = tokens.at(3).toDouble();
-            pGLWidget->setRotation(q0, q1, q2, q3);
+        if(command.nValues == 4) {
+            q0 = float(command.value[0]);
+            q1 = float(command.value[1]);
+            q2 = float(command.value[2]);
+            q3 = float(command.value[3]);
+            // Replayed samples have no read time: stamped now
+            pGLWidget->addRotation(command.readMicros ? command.readMicros : micros(),
+                                   q0, q1, q2, q3);
+            repaintScheduler.markDirty(iCubeTarget);
         }
     }
     else if(cmd == 'p') { // PID Input & Output values
-        if(tokens.count() > 1) {
-            double x = tokens.at(0).toDouble();
-            double input = tokens.at(1).toDouble();
-            pPlotVal->NewPoint(4, x, double(input));
-            if(tokens.count() == 3) {
-                double output = tokens.at(2).toDouble();
-                pPlotVal->NewPoint(5, x, double(output));
+        if(command.nValues > 1) {
+            double x = command.value[0];
+            double input = command.value[1];
+            pPlotVal->NewPoint(4, x, input);
+            if(command.nValues == 3) {
+                double output = command.value[2];
+                pPlotVal->NewPoint(5, x, output);
             }
             else
                 pPlotVal->ClearDataSet(5);
+            repaintScheduler.markDirty(iPlotTarget);
         }
     }
     else if(cmd == 'c') { // Robot Configuration Values
+        // Rare message: the original text is shown as is (the binary
+        // frames only carry the values)
+        QStringList tokens;
+        if(command.pText) {
+            tokens = QString::fromLatin1(command.pText, command.nTextLength)
+                     .split(' ', Qt::SkipEmptyParts);
+            if(!tokens.isEmpty()) tokens.removeFirst();
+        }
+        else {
+            for(int i=0; i<command.nValues; i++)
+                tokens.append(QString::number(command.value[i]));
+        }
         if(tokens.count() == 6) {
             editKp->setText(tokens.at(0));
             editKi->setText(tokens.at(1));
@@ -414,34 +708,46 @@ MainWidget::executeCommand(QString command) {
     else if(cmd == 'r') { // Reset
         pPlotVal->ClearDataSet(4);
         pPlotVal->ClearDataSet(5);
+        repaintScheduler.markDirty(iPlotTarget);
+    }
+    else if(cmd == 'b') { // Binary Telemetry Accepted
+        if(command.nValues == 1)
+            statusBar->showMessage(QString("Binary telemetry (version %1)")
+                                   .arg(int(command.value[0])));
+    }
+    else if(cmd == 'e') { // Echo Reply: only the last probe is timed
+        if(command.nValues == 1 && pingSent && quint32(command.value[0]) == pingId) {
+            latency[latencyRoundTrip].record(micros()-pingSent);
+            pingSent = 0;
+        }
     }
 }
 
 
 void
 MainWidget::onButtonClosePushed() {
-    if(tcpClient.isOpen()) {
+    if(bConnected) {
         message.clear();
         message.append("K#"); // Kill Remote Program
-        tcpClient.write(message);
+        sendOrder(message);
     }
 }
 
 
 void
 MainWidget::onButtonManualPushed() {
-    if(tcpClient.isOpen()) {
+    if(bConnected) {
         message.clear();
         if(bPIDInControl) {
             message.append("S#"); // Set Manual Control
-            tcpClient.write(message);
+            sendOrder(message);
             bPIDInControl = false;
             buttonManualControl->setText("PID Ctrl");
             setDisableUI(false);
         }
         else {
             message.append("G#"); // Go !
-            tcpClient.write(message);
+            sendOrder(message);
             bPIDInControl = true;
             buttonManualControl->setText("Manual Control");
             setDisableUI(true);
@@ -458,32 +764,182 @@ MainWidget::onButtonManualPushed() {
 
 void
 MainWidget::askConfiguration() {
-    if(tcpClient.isOpen()) {
+    if(bConnected) {
         message.clear();
         message.append("C#"); // Ask Robot Configuration
-        tcpClient.write(message);
+        sendOrder(message);
     }
 }
 
 
 void
 MainWidget::onStartMovePushed() {
-    if(tcpClient.isOpen()) {
+    if(bConnected) {
         QString sMessage = QString("M %1 %2#")
                 .arg(editMoveSpeedL->text(), editMoveSpeedR->text()); // Start Moving
-        tcpClient.write(sMessage.toLatin1());
+        sendOrder(sMessage.toLatin1());
     }
 }
 
 
 void
 MainWidget::onSetPIDPushed() {
-    if(tcpClient.isOpen()) {
+    if(bConnected) {
         QString sMessage = QString("P %1 %2 %3 %4#")
                 .arg(editKp->text(),
                      editKi->text(),
                      editKd->text(),
                      editSetpoint->text());
-        tcpClient.write(sMessage.toLatin1());
+        sendOrder(sMessage.toLatin1());
+    }
+}
+
+
+// The recording runs in the network thread, from the socket to the file
+void
+MainWidget::onRecordPushed() {
+    buttonRecord->setDisabled(true);
+    if(bRecording) {
+        emit stopRecording();
+    }
+    else {
+        QString sBasePath = QDir(sRecordPath).filePath(
+                    QString("telemetry-%1")
+                    .arg(QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss")));
+        emit startRecording(sBasePath);
+    }
+}
+
+
+void
+MainWidget::onRecordingStarted(bool bOk, QString sBasePath) {
+    buttonRecord->setEnabled(true);
+    if(!bOk) {
+        statusBar->showMessage(QString("Unable to record in %1").arg(sBasePath));
+        return;
+    }
+    bRecording = true;
+    buttonRecord->setText("Stop Rec");
+    statusBar->showMessage(QString("Recording to %1").arg(sBasePath));
+}
+
+
+void
+MainWidget::onRecordingStopped(quint64 nMessages) {
+    bRecording = false;
+    buttonRecord->setEnabled(true);
+    buttonRecord->setText("Record");
+    statusBar->showMessage(QString("Recorded %1 messages").arg(nMessages));
+}
+
+
+void
+MainWidget::onReplayPushed() {
+    if(replay.isRunning()) {
+        stopReplay();
+        return;
+    }
+    QString sFileName = QFileDialog::getOpenFileName(this, "Replay a recorded session",
+                                                     sRecordPath,
+                                                     "Telemetry (*.idx *.seg)");
+    if(sFileName.isEmpty()) return;
+    double speed = comboReplaySpeed->currentData().toDouble();
+    if(!replay.start(TelemetryLogReader::basePathOf(sFileName), speed)) {
+        statusBar->showMessage(QString("Unable to replay %1").arg(sFileName));
+        return;
+    }
+    pPlotVal->ClearDataSet(4);
+    pPlotVal->ClearDataSet(5);
+    nReplayed        = 0;
+    nReplayFrames    = 0;
+    replayFrameTotal = 0;
+    replayFrameMax   = 0;
+    buttonReplay->setText("Stop Replay");
+    buttonReplayBack->setEnabled(true);
+    buttonReplayForward->setEnabled(true);
+    comboReplaySpeed->setDisabled(true);
+    statusBar->showMessage(QString("Replaying %1").arg(sFileName));
+    replayClock.start();
+    // Every tick replays a frame of 100ms of recorded time (times the
+    // speed); at the maximum speed the ticks follow one another
+    timerReplay.start(speed > 0.0 ? 100 : 0);
+}
+
+
+void
+MainWidget::onReplayTick() {
+    QElapsedTimer frameClock;
+    frameClock.start();
+    double speed = replay.speed();
+    replay.beginFrame(quint64(100000.0*(speed > 0.0 ? speed : 1.0)));
+    TelemetryMessage sample;
+    while(replay.nextMessage(&sample)) {
+        processSample(sample);
+        nReplayed++;
+    }
+    flushPidSamples();
+    if(speed <= 0.0) {
+        // Frame time measured with a synchronous paint
+        pPlotVal->UpdatePlot();
+        pPlotVal->repaint();
+        pGLWidget->repaint();
+    }
+    qint64 frameTime = frameClock.nsecsElapsed();
+    nReplayFrames++;
+    replayFrameTotal += frameTime;
+    replayFrameMax = qMax(replayFrameMax, frameTime);
+    if(replay.atEnd())
+        stopReplay();
+}
+
+
+void
+MainWidget::stopReplay() {
+    timerReplay.stop();
+    replay.stop();
+    buttonReplay->setText("Replay");
+    buttonReplayBack->setDisabled(true);
+    buttonReplayForward->setDisabled(true);
+    comboReplaySpeed->setEnabled(true);
+    double elapsed = replayClock.nsecsElapsed()*1.0e-9;
+    QString sReport = QString("Replayed %1 samples in %2s (%3 samples/s), frame time avg %4ms max %5ms")
+            .arg(nReplayed)
+            .arg(elapsed, 0, 'f', 2)
+            .arg(elapsed > 0.0 ? nReplayed/elapsed : 0.0, 0, 'f', 0)
+            .arg(nReplayFrames > 0 ? replayFrameTotal*1.0e-6/nReplayFrames : 0.0, 0, 'f', 2)
+            .arg(replayFrameMax*1.0e-6, 0, 'f', 2);
+    statusBar->showMessage(sReport);
+}
+
+
+void
+MainWidget::onReplayBackPushed() {
+    seekReplay(-10000000);
+}
+
+
+void
+MainWidget::onReplayForwardPushed() {
+    seekReplay(10000000);
+}
+
+
+// Random access through the session index: the plot restarts from the
+// new position
+void
+MainWidget::seekReplay(qint64 deltaMicros) {
+    if(!replay.isRunning()) return;
+    qint64 position = qMax(qint64(0), qint64(replay.position())+deltaMicros);
+    if(!replay.seek(quint64(position))) {
+        stopReplay();
+        return;
     }
+    pidTime.clear();
+    pidInput.clear();
+    pidOutput.clear();
+    pidRead.clear();
+    pPlotVal->ClearDataSet(4);
+    pPlotVal->ClearDataSet(5);
+    repaintScheduler.markDirty(iPlotTarget);
+    statusBar->showMessage(QString("Replaying from %1s").arg(position*1.0e-6, 0, 'f', 1));
 }
@@ -1,11 +1,18 @@
 #pragma once
 
 #include <QWidget>
-#include <QTcpSocket>
+#include <QAbstractSocket>
 #include <QHostAddress>
 #include <QHostInfo>
 #include <QByteArray>
 #include <QTimer>
+#include <QThread>
+#include <QVector>
+#include <QElapsedTimer>
+
+#include "telemetryreplay.h"
+#include "latencyhistogram.h"
+#include "repaintscheduler.h"
 
 
 QT_FORWARD_DECLARE_CLASS(GLWidget)
@@ -14,8 +21,9 @@ QT_FORWARD_DECLARE_CLASS(QHBoxLayout)
 QT_FORWARD_DECLARE_CLASS(QLineEdit)
 QT_FORWARD_DECLARE_CLASS(QLabel)
 QT_FORWARD_DECLARE_CLASS(Plot2D)
-QT_FORWARD_DECLARE_CLASS(QUdpSocket)
+QT_FORWARD_DECLARE_CLASS(NetworkWorker)
 QT_FORWARD_DECLARE_CLASS(QStatusBar)
+QT_FORWARD_DECLARE_CLASS(QComboBox)
 
 
 class MainWidget : public QWidget
@@ -26,19 +34,40 @@ public:
     MainWidget(QWidget *parent = nullptr);
     ~MainWidget();
 
+signals:
+    void connectToRobot(QHostAddress address, quint16 port);
+    void disconnectFromRobot();
+    void sendToRobot(QByteArray message, quint64 queuedMicros);
+    void startRecording(QString sBasePath);
+    void stopRecording();
+
 public slots:
     void onButtonClosePushed();
     void onConnectToClient();
     void handleLookup(QHostInfo hostInfo);
-    void displayError(QAbstractSocket::SocketError socketError);
+    void displayError(int socketError, QString sError);
     void onServerConnected();
     void onServerDisconnected();
-    void onNewDataAvailable();
-    void onReadPendingDatagrams();
+    void onUdpBindFailed();
+    void onMessageReceived(QByteArray received);
     void onButtonManualPushed();
     void onStartMovePushed();
     void onSetPIDPushed();
     void onTimeToUpdateWidgets();
+    void onSamplesAvailable();
+    void onRecordPushed();
+    void onRecordingStarted(bool bOk, QString sBasePath);
+    void onRecordingStopped(quint64 nMessages);
+    void onReplayPushed();
+    void onReplayTick();
+    void onReplayBackPushed();
+    void onReplayForwardPushed();
+    void onLatencyPushed();
+    void onLatencyReset();
+    void onTimeToPing();
+    void onPlotPainted();
+    void onCubePainted();
+    void onCubePlayoutPending();
 
 protected:
     void closeEvent(QCloseEvent *event);
@@ -48,18 +77,32 @@ protected:
     void saveSettings();
     void createUi();
     void createPlot();
-    void executeCommand(QString command);
+    void drainTelemetry();
+    void updateStatus();
+    void processSample(const TelemetryMessage& sample);
+    void stopReplay();
+    void seekReplay(qint64 deltaMicros);
+    void flushPidSamples();
+    void recordInsert(quint64 readMicros, QVector<quint64>* pPending);
+    void recordDisplay(QVector<quint64>* pPending);
+    void executeCommand(const TelemetryMessage& command);
     void setDisableUI(bool bDisable);
     void askConfiguration();
+    void sendOrder(const QByteArray& order);
 
 private:
-    QTcpSocket   tcpClient;
-    QHostAddress serverAddress;
-    QByteArray   message;
-    QString      receivedCommand;
-
-    QUdpSocket*  pUdpSocket;
-    int          udpPort;
+    QThread        networkThread;
+    NetworkWorker* pNetworkWorker;
+    bool           bConnected;
+    QHostAddress   serverAddress;
+    QByteArray     message;
+    bool           bBinaryTelemetry; // Ask the binary message format
+    bool           bUdpBatchReceive; // recvmmsg() where available
+    int            udpPort;
+    QString        sRecordPath;      // Where the sessions are recorded
+    bool           bRecording;
+    QVector<double> pidTime, pidInput, pidOutput; // Drained 'p' samples
+    QVector<quint64> pidRead;                     // and their read time
 
     GLWidget* pGLWidget;
     Plot2D*   pPlotVal;
@@ -69,6 +112,12 @@ private:
     QHBoxLayout* thirdButtonRow;
 
     QPushButton* buttonManualControl;
+    QPushButton* buttonRecord;
+    QPushButton* buttonReplay;
+    QPushButton* buttonReplayBack;
+    QPushButton* buttonReplayForward;
+    QComboBox*   comboReplaySpeed;
+    QPushButton* buttonLatency;
 
     QPushButton* buttonClose;
     QPushButton* buttonConnect;
@@ -92,9 +141,30 @@ private:
     QLineEdit*   editSetpoint;
 
     QStatusBar*  statusBar;
+    QLabel*      labelIngest;
+    QLabel*      labelLink;
 
     bool bPIDInControl;
 
     float q0, q1, q2, q3;
-    QTimer timerUpdate;
+    QTimer timerUpdate;      // Status only: the widgets follow the data
+    RepaintScheduler repaintScheduler;
+    int    iCubeTarget, iPlotTarget;
+    double maxFps;           // 0: display refresh rate
+    int    playoutDelay;     // ms the cube stays behind the samples
+
+    // Replay of a recorded session
+    TelemetryReplay replay;
+    QTimer          timerReplay;
+    QElapsedTimer   replayClock;
+    quint64         nReplayed;
+    int             nReplayFrames;
+    qint64          replayFrameTotal, replayFrameMax; // ns
+
+    // Latency of the live telemetry (us)
+    LatencyHistogram latency[nLatencyStages];
+    QVector<quint64> plotPending, cubePending; // Read times not yet painted
+    QTimer           timerPing;
+    quint32          pingId;
+    quint64          pingSent;                 // 0: no echo pending
 };
@@ -0,0 +1,615 @@
+/*
+ *
+Copyright (C) 2016  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include "meshloader.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QStandardPaths>
+#include <QtEndian>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+// Cache file: header, vertices, indices (native byte order: the cache
+// is a local file, rebuilt whenever it does not match)
+#define MESH_CACHE_MAGIC   "SBMESH1"
+#define MESH_CACHE_VERSION 1
+// Post transform cache size assumed by the optimization
+#define VERTEX_CACHE_SIZE  16
+
+struct MeshCacheHeader
+{
+    char    magic[8];
+    quint32 version;
+    quint32 vertexSize;
+    quint32 indexSize;
+    quint32 nVertices;
+    quint32 nIndices;
+    quint32 reserved;
+    qint64  sourceSize;
+    qint64  sourceModified; // ms since the epoch
+};
+
+
+bool
+operator==(const MeshVertex& a, const MeshVertex& b) {
+    return memcmp(&a, &b, sizeof(MeshVertex)) == 0;
+}
+
+
+uint
+qHash(const MeshVertex& vertex, uint seed) {
+    return qHashBits(&vertex, sizeof(MeshVertex), seed);
+}
+
+
+MeshLoader::MeshLoader()
+    : pCacheFile(nullptr)
+    , pMapped(nullptr)
+    , pVertices(nullptr)
+    , pIndices(nullptr)
+    , nVertices(0)
+    , nIndices(0)
+    , iIndexSize(2)
+{
+}
+
+
+MeshLoader::~MeshLoader() {
+    release();
+}
+
+
+void
+MeshLoader::release() {
+    if(pCacheFile) {
+        if(pMapped) pCacheFile->unmap(pMapped);
+        delete pCacheFile;
+        pCacheFile = nullptr;
+    }
+    pMapped   = nullptr;
+    pVertices = nullptr;
+    pIndices  = nullptr;
+    nVertices = 0;
+    nIndices  = 0;
+    converted.vertices.clear();
+    converted.indices.clear();
+}
+
+
+const MeshVertex*
+MeshLoader::vertices() const {
+    return pVertices;
+}
+
+
+int
+MeshLoader::vertexCount() const {
+    return nVertices;
+}
+
+
+const void*
+MeshLoader::indices() const {
+    return pIndices;
+}
+
+
+int
+MeshLoader::indexCount() const {
+    return nIndices;
+}
+
+
+int
+MeshLoader::indexSize() const {
+    return iIndexSize;
+}
+
+
+QString
+MeshLoader::report() const {
+    return sReport;
+}
+
+
+QString
+MeshLoader::errorString() const {
+    return sError;
+}
+
+
+QString
+MeshLoader::cachePath(QString sFileName) {
+    QString sDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    QFileInfo info(sFileName);
+    // The hash keeps apart the models with the same name
+    QString sKey = QString::number(qHash(info.absoluteFilePath()), 16);
+    return QString("%1/%2-%3.sbmesh").arg(sDir, info.completeBaseName(), sKey);
+}
+
+
+bool
+MeshLoader::load(QString sFileName) {
+    release();
+    sError.clear();
+    QElapsedTimer timer;
+    timer.start();
+    QFileInfo info(sFileName);
+    if(!info.exists()) {
+        sError = QString("%1 not found").arg(sFileName);
+        return false;
+    }
+    qint64 sourceModified = info.lastModified().toMSecsSinceEpoch();
+    QString sCacheName = cachePath(sFileName);
+    if(mapCache(sCacheName, info.size(), sourceModified)) {
+        sReport = QString("%1: %2 triangles from the cache in %3 ms")
+                  .arg(info.fileName())
+                  .arg(nIndices/3)
+                  .arg(timer.nsecsElapsed()*1.0e-6, 0, 'f', 2);
+        return true;
+    }
+
+    // First run (or changed model): the text is parsed once
+    QFile file(sFileName);
+    if(!file.open(QIODevice::ReadOnly)) {
+        sError = file.errorString();
+        return false;
+    }
+    QByteArray data = file.readAll();
+    file.close();
+    MeshData mesh;
+    bool bOk = info.suffix().compare("stl", Qt::CaseInsensitive) == 0 ?
+               parseStl(data, &mesh) : parseObj(data, &mesh);
+    if(!bOk || mesh.indices.isEmpty()) {
+        sError = QString("%1: no triangles").arg(sFileName);
+        return false;
+    }
+    int nCorners = mesh.vertices.count();
+    weld(&mesh);
+    double acmrBefore = acmr(mesh.indices, VERTEX_CACHE_SIZE);
+    optimize(&mesh, VERTEX_CACHE_SIZE);
+    double acmrAfter = acmr(mesh.indices, VERTEX_CACHE_SIZE);
+    normalize(&mesh);
+    if(!writeCache(sCacheName, mesh, info.size(), sourceModified) ||
+       !mapCache(sCacheName, info.size(), sourceModified))
+    {
+        // Not cached: uploaded from memory
+        converted  = mesh;
+        pVertices  = converted.vertices.constData();
+        nVertices  = converted.vertices.count();
+        pIndices   = converted.indices.constData();
+        nIndices   = converted.indices.count();
+        iIndexSize = 4;
+    }
+    sReport = QString("%1: %2 triangles, %3 -> %4 vertices, ACMR %5 -> %6, converted in %7 ms")
+              .arg(info.fileName())
+              .arg(nIndices/3)
+              .arg(nCorners)
+              .arg(nVertices)
+              .arg(acmrBefore, 0, 'f', 2)
+              .arg(acmrAfter, 0, 'f', 2)
+              .arg(timer.nsecsElapsed()*1.0e-6, 0, 'f', 1);
+    return true;
+}
+
+
+bool
+MeshLoader::mapCache(QString sCacheName, qint64 sourceSize, qint64 sourceModified) {
+    pCacheFile = new QFile(sCacheName);
+    if(!pCacheFile->open(QIODevice::ReadOnly) ||
+       pCacheFile->size() < qint64(sizeof(MeshCacheHeader)))
+    {
+        release();
+        return false;
+    }
+    pMapped = pCacheFile->map(0, pCacheFile->size());
+    if(!pMapped) {
+        release();
+        return false;
+    }
+    const MeshCacheHeader* pHeader = reinterpret_cast<const MeshCacheHeader*>(pMapped);
+    qint64 vertexBytes = qint64(pHeader->nVertices)*qint64(sizeof(MeshVertex));
+    qint64 indexBytes  = qint64(pHeader->nIndices)*qint64(pHeader->indexSize);
+    if(memcmp(pHeader->magic, MESH_CACHE_MAGIC, sizeof(pHeader->magic)) != 0 ||
+       pHeader->version != MESH_CACHE_VERSION ||
+       pHeader->vertexSize != sizeof(MeshVertex) ||
+       (pHeader->indexSize != 2 && pHeader->indexSize != 4) ||
+       pHeader->sourceSize != sourceSize ||
+       pHeader->sourceModified != sourceModified ||
+       pCacheFile->size() < qint64(sizeof(MeshCacheHeader))+vertexBytes+indexBytes)
+    {
+        release();
+        return false;
+    }
+    pVertices  = reinterpret_cast<const MeshVertex*>(pMapped+sizeof(MeshCacheHeader));
+    pIndices   = pMapped+sizeof(MeshCacheHeader)+vertexBytes;
+    nVertices  = int(pHeader->nVertices);
+    nIndices   = int(pHeader->nIndices);
+    iIndexSize = int(pHeader->indexSize);
+    return true;
+}
+
+
+// 16 bit indices whenever possible (i.e. OpenGL ES 2.0)
+bool
+MeshLoader::writeCache(QString sCacheName, const MeshData& mesh,
+                       qint64 sourceSize, qint64 sourceModified)
+{
+    QDir().mkpath(QFileInfo(sCacheName).absolutePath());
+    QFile file(sCacheName);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    MeshCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+    header.version        = MESH_CACHE_VERSION;
+    header.vertexSize     = sizeof(MeshVertex);
+    header.indexSize      = mesh.vertices.count() <= 65536 ? 2 : 4;
+    header.nVertices      = quint32(mesh.vertices.count());
+    header.nIndices       = quint32(mesh.indices.count());
+    header.sourceSize     = sourceSize;
+    header.sourceModified = sourceModified;
+    bool bOk = file.write(reinterpret_cast<const char*>(&header), sizeof(header)) == qint64(sizeof(header));
+    qint64 vertexBytes = qint64(mesh.vertices.count())*qint64(sizeof(MeshVertex));
+    bOk = bOk && file.write(reinterpret_cast<const char*>(mesh.vertices.constData()), vertexBytes) == vertexBytes;
+    if(header.indexSize == 2) {
+        QVector<quint16> shortIndices(mesh.indices.count());
+        for(int i=0; i<mesh.indices.count(); i++)
+            shortIndices[i] = quint16(mesh.indices.at(i));
+        qint64 indexBytes = qint64(shortIndices.count())*2;
+        bOk = bOk && file.write(reinterpret_cast<const char*>(shortIndices.constData()), indexBytes) == indexBytes;
+    }
+    else {
+        qint64 indexBytes = qint64(mesh.indices.count())*4;
+        bOk = bOk && file.write(reinterpret_cast<const char*>(mesh.indices.constData()), indexBytes) == indexBytes;
+    }
+    file.close();
+    if(!bOk) file.remove();
+    return bOk;
+}
+
+
+static const char*
+skipBlanks(const char* p, const char* pEnd) {
+    while(p < pEnd && (*p == ' ' || *p == '\t')) p++;
+    return p;
+}
+
+
+// Vertex reference of a face: "v", "v/vt", "v//vn" or "v/vt/vn",
+// 1 based or negative (relative to the end)
+static bool
+parseFaceVertex(const char** pp, const char* pEnd, int nPositions, int nTexCoords,
+                int* piPosition, int* piTexCoord)
+{
+    char* pNext;
+    long iPosition = strtol(*pp, &pNext, 10);
+    if(pNext == *pp) return false;
+    long iTexCoord = 0;
+    const char* p = pNext;
+    if(p < pEnd && *p == '/') {
+        p++;
+        if(p < pEnd && *p != '/') {
+            iTexCoord = strtol(p, &pNext, 10);
+            p = pNext;
+        }
+        if(p < pEnd && *p == '/') { // The normal is not used
+            p++;
+            strtol(p, &pNext, 10);
+            p = pNext;
+        }
+    }
+    *pp = p;
+    *piPosition = int(iPosition < 0 ? nPositions+iPosition : iPosition-1);
+    *piTexCoord = int(iTexCoord < 0 ? nTexCoords+iTexCoord : iTexCoord-1);
+    return *piPosition >= 0 && *piPosition < nPositions;
+}
+
+
+// The polygons are split in triangle fans; every corner becomes a
+// vertex (see weld())
+bool
+MeshLoader::parseObj(const QByteArray& text, MeshData* pMesh) {
+    QVector<float> positions, texCoords;
+    const char* p    = text.constData();
+    const char* pEnd = p+text.size();
+    QVector<MeshVertex> polygon;
+    while(p < pEnd) {
+        const char* pLineEnd = static_cast<const char*>(memchr(p, '\n', size_t(pEnd-p)));
+        if(!pLineEnd) pLineEnd = pEnd;
+        p = skipBlanks(p, pLineEnd);
+        if(pLineEnd-p > 2 && p[0] == 'v' && p[1] == ' ') {
+            char* pNext;
+            const char* q = p+2;
+            for(int i=0; i<3; i++) {
+                positions.append(float(strtod(q, &pNext)));
+                q = pNext;
+            }
+        }
+        else if(pLineEnd-p > 3 && p[0] == 'v' && p[1] == 't' && p[2] == ' ') {
+            char* pNext;
+            const char* q = p+3;
+            for(int i=0; i<2; i++) {
+                texCoords.append(float(strtod(q, &pNext)));
+                q = pNext;
+            }
+        }
+        else if(pLineEnd-p > 2 && p[0] == 'f' && p[1] == ' ') {
+            polygon.clear();
+            const char* q = skipBlanks(p+2, pLineEnd);
+            int iPosition, iTexCoord;
+            while(q < pLineEnd && *q != '\r' &&
+                  parseFaceVertex(&q, pLineEnd, positions.count()/3, texCoords.count()/2,
+                                  &iPosition, &iTexCoord))
+            {
+                MeshVertex vertex;
+                memcpy(vertex.position, positions.constData()+3*iPosition, sizeof(vertex.position));
+                if(iTexCoord >= 0 && iTexCoord < texCoords.count()/2)
+                    memcpy(vertex.texCoord, texCoords.constData()+2*iTexCoord, sizeof(vertex.texCoord));
+                else
+                    vertex.texCoord[0] = vertex.texCoord[1] = 0.0f;
+                polygon.append(vertex);
+                q = skipBlanks(q, pLineEnd);
+            }
+            for(int i=2; i<polygon.count(); i++) {
+                const MeshVertex* pCorner[3] = { &polygon.at(0), &polygon.at(i-1), &polygon.at(i) };
+                for(int j=0; j<3; j++) {
+                    pMesh->indices.append(quint32(pMesh->vertices.count()));
+                    pMesh->vertices.append(*pCorner[j]);
+                }
+            }
+        }
+        p = pLineEnd+1;
+    }
+    return !pMesh->indices.isEmpty();
+}
+
+
+static void
+appendStlCorner(MeshData* pMesh, const float* position) {
+    MeshVertex vertex;
+    memcpy(vertex.position, position, sizeof(vertex.position));
+    vertex.texCoord[0] = vertex.texCoord[1] = 0.0f; // See normalize()
+    pMesh->indices.append(quint32(pMesh->vertices.count()));
+    pMesh->vertices.append(vertex);
+}
+
+
+// Binary when the size matches the triangle count of the header,
+// ASCII ("vertex x y z" lines) otherwise
+bool
+MeshLoader::parseStl(const QByteArray& data, MeshData* pMesh) {
+    if(data.size() >= 84) {
+        quint32 nTriangles = qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(data.constData()+80));
+        if(qint64(data.size()) == 84+50*qint64(nTriangles)) {
+            const uchar* p = reinterpret_cast<const uchar*>(data.constData()+84);
+            for(quint32 i=0; i<nTriangles; i++, p+=50) {
+                for(int j=0; j<3; j++) { // After the normal
+                    float position[3];
+                    for(int k=0; k<3; k++) {
+                        quint32 bits = qFromLittleEndian<quint32>(p+12+12*j+4*k);
+                        memcpy(&position[k], &bits, sizeof(float));
+                    }
+                    appendStlCorner(pMesh, position);
+                }
+            }
+            return nTriangles > 0;
+        }
+    }
+    const char* p    = data.constData();
+    const char* pEnd = p+data.size();
+    while(p < pEnd) {
+        const char* pLineEnd = static_cast<const char*>(memchr(p, '\n', size_t(pEnd-p)));
+        if(!pLineEnd) pLineEnd = pEnd;
+        p = skipBlanks(p, pLineEnd);
+        if(pLineEnd-p > 7 && strncmp(p, "vertex ", 7) == 0) {
+            float position[3];
+            char* pNext;
+            const char* q = p+7;
+            for(int k=0; k<3; k++) {
+                position[k] = float(strtod(q, &pNext));
+                q = pNext;
+            }
+            appendStlCorner(pMesh, position);
+        }
+        p = pLineEnd+1;
+    }
+    // Only whole triangles
+    int nExtra = pMesh->indices.count()%3;
+    pMesh->indices.resize(pMesh->indices.count()-nExtra);
+    return !pMesh->indices.isEmpty();
+}
+
+
+// Identical vertices are merged (exact match of all the attributes)
+void
+MeshLoader::weld(MeshData* pMesh) {
+    QHash<MeshVertex, quint32> unique;
+    unique.reserve(pMesh->vertices.count());
+    QVector<MeshVertex> vertices;
+    vertices.reserve(pMesh->vertices.count());
+    for(int i=0; i<pMesh->indices.count(); i++) {
+        const MeshVertex& vertex = pMesh->vertices.at(int(pMesh->indices.at(i)));
+        QHash<MeshVertex, quint32>::const_iterator it = unique.constFind(vertex);
+        if(it == unique.constEnd()) {
+            it = unique.insert(vertex, quint32(vertices.count()));
+            vertices.append(vertex);
+        }
+        pMesh->indices[i] = it.value();
+    }
+    pMesh->vertices = vertices;
+}
+
+
+// Tipsify (Sander, Nehab and Barczak, 2007): the triangles are emitted
+// fanning around the vertices still in the cache, in linear time. Then
+// the vertices are renumbered in the order of their first use.
+void
+MeshLoader::optimize(MeshData* pMesh, int cacheSize) {
+    int nVertices  = pMesh->vertices.count();
+    int nTriangles = pMesh->indices.count()/3;
+    if(nTriangles == 0) return;
+    const quint32* pIndices = pMesh->indices.constData();
+
+    // Triangles around each vertex
+    QVector<int> live(nVertices, 0);
+    for(int i=0; i<3*nTriangles; i++)
+        live[int(pIndices[i])]++;
+    QVector<int> adjacencyStart(nVertices+1, 0);
+    for(int v=0; v<nVertices; v++)
+        adjacencyStart[v+1] = adjacencyStart[v]+live.at(v);
+    QVector<int> adjacency(3*nTriangles);
+    QVector<int> fill(adjacencyStart);
+    for(int t=0; t<nTriangles; t++)
+        for(int j=0; j<3; j++)
+            adjacency[fill[int(pIndices[3*t+j])]++] = t;
+
+    QVector<int>  cacheTime(nVertices, 0);
+    QVector<bool> emitted(nTriangles, false);
+    QVector<int>  deadEnd;
+    QVector<int>  candidates;
+    QVector<quint32> output;
+    output.reserve(3*nTriangles);
+    int iFan = 0;
+    int iTime = cacheSize+1;
+    int iCursor = 1;
+    while(iFan >= 0) {
+        candidates.clear();
+        for(int a=adjacencyStart.at(iFan); a<adjacencyStart.at(iFan+1); a++) {
+            int t = adjacency.at(a);
+            if(emitted.at(t)) continue;
+            for(int j=0; j<3; j++) {
+                int v = int(pIndices[3*t+j]);
+                output.append(quint32(v));
+                deadEnd.append(v);
+                candidates.append(v);
+                live[v]--;
+                if(iTime-cacheTime.at(v) > cacheSize)
+                    cacheTime[v] = iTime++;
+            }
+            emitted[t] = true;
+        }
+        // Next fan: the candidate staying longest in the cache
+        int iBest = -1, bestPriority = -1;
+        for(int i=0; i<candidates.count(); i++) {
+            int v = candidates.at(i);
+            if(live.at(v) <= 0) continue;
+            int priority = 0;
+            if(iTime-cacheTime.at(v)+2*live.at(v) <= cacheSize)
+                priority = iTime-cacheTime.at(v);
+            if(priority > bestPriority) {
+                bestPriority = priority;
+                iBest = v;
+            }
+        }
+        if(iBest < 0) {
+            while(!deadEnd.isEmpty()) {
+                int v = deadEnd.takeLast();
+                if(live.at(v) > 0) {
+                    iBest = v;
+                    break;
+                }
+            }
+        }
+        while(iBest < 0 && iCursor < nVertices) {
+            if(live.at(iCursor) > 0) iBest = iCursor;
+            iCursor++;
+        }
+        iFan = iBest;
+    }
+
+    // Vertex fetch order
+    QVector<int> remap(nVertices, -1);
+    QVector<MeshVertex> vertices;
+    vertices.reserve(nVertices);
+    for(int i=0; i<output.count(); i++) {
+        int v = int(output.at(i));
+        if(remap.at(v) < 0) {
+            remap[v] = vertices.count();
+            vertices.append(pMesh->vertices.at(v));
+        }
+        output[i] = quint32(remap.at(v));
+    }
+    pMesh->vertices = vertices;
+    pMesh->indices  = output;
+}
+
+
+// Centered in the unit sphere (the view of the cube). The models without
+// texture coordinates get a planar projection on the XY plane.
+void
+MeshLoader::normalize(MeshData* pMesh) {
+    if(pMesh->vertices.isEmpty()) return;
+    float lo[3], hi[3];
+    for(int k=0; k<3; k++)
+        lo[k] = hi[k] = pMesh->vertices.at(0).position[k];
+    bool bTextured = false;
+    for(int i=0; i<pMesh->vertices.count(); i++) {
+        const MeshVertex& vertex = pMesh->vertices.at(i);
+        for(int k=0; k<3; k++) {
+            lo[k] = qMin(lo[k], vertex.position[k]);
+            hi[k] = qMax(hi[k], vertex.position[k]);
+        }
+        if(vertex.texCoord[0] != 0.0f || vertex.texCoord[1] != 0.0f)
+            bTextured = true;
+    }
+    float center[3], radius = 0.0f;
+    for(int k=0; k<3; k++) {
+        center[k] = 0.5f*(lo[k]+hi[k]);
+        radius += 0.25f*(hi[k]-lo[k])*(hi[k]-lo[k]);
+    }
+    radius = sqrtf(radius);
+    float scale = radius > 0.0f ? 1.0f/radius : 1.0f;
+    float width  = hi[0] > lo[0] ? hi[0]-lo[0] : 1.0f;
+    float height = hi[1] > lo[1] ? hi[1]-lo[1] : 1.0f;
+    for(int i=0; i<pMesh->vertices.count(); i++) {
+        MeshVertex& vertex = pMesh->vertices[i];
+        if(!bTextured) {
+            vertex.texCoord[0] = (vertex.position[0]-lo[0])/width;
+            vertex.texCoord[1] = (vertex.position[1]-lo[1])/height;
+        }
+        for(int k=0; k<3; k++)
+            vertex.position[k] = (vertex.position[k]-center[k])*scale;
+    }
+}
+
+
+// Average cache miss ratio (vertices transformed per triangle) of a
+// FIFO post transform cache
+double
+MeshLoader::acmr(const QVector<quint32>& indices, int cacheSize) {
+    int nTriangles = indices.count()/3;
+    if(nTriangles == 0) return 0.0;
+    QHash<quint32, int> inCache; // Vertex -> time of insertion
+    int nMisses = 0;
+    for(int i=0; i<indices.count(); i++) {
+        quint32 v = indices.at(i);
+        QHash<quint32, int>::const_iterator it = inCache.constFind(v);
+        if(it != inCache.constEnd() && nMisses-it.value() < cacheSize)
+            continue;
+        inCache.insert(v, nMisses);
+        nMisses++;
+    }
+    return double(nMisses)/double(nTriangles);
+}
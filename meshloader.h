@@ -0,0 +1,98 @@
+/*
+ *
+Copyright (C) 2016  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QString>
+#include <QByteArray>
+#include <QVector>
+#include <QHash>
+
+
+QT_FORWARD_DECLARE_CLASS(QFile)
+
+
+// Interleaved vertex of the meshes, laid out like the VertexData of the
+// cube (the shaders only know a_position and a_texcoord)
+struct MeshVertex
+{
+    float position[3];
+    float texCoord[2];
+};
+
+bool operator==(const MeshVertex& a, const MeshVertex& b);
+uint qHash(const MeshVertex& vertex, uint seed = 0);
+
+
+// Indexed triangle list
+struct MeshData
+{
+    QVector<MeshVertex> vertices;
+    QVector<quint32>    indices;
+};
+
+
+// Mesh loading for GeometryEngine. The OBJ and STL (ASCII or binary)
+// files are converted once: the vertices are deduplicated, the triangles
+// reordered for the post transform cache (Tipsify), the vertices for the
+// fetch order, and the model scaled into the unit sphere. The result is
+// written to a binary cache that later runs map and upload as is.
+class MeshLoader
+{
+public:
+    MeshLoader();
+    ~MeshLoader();
+
+    bool load(QString sFileName);
+    void release();
+
+    // Valid after load() until release()
+    const MeshVertex* vertices() const;
+    int  vertexCount() const;
+    const void* indices() const;
+    int  indexCount() const;
+    int  indexSize() const;  // 2 or 4 bytes
+
+    QString report() const;  // Load time and statistics
+    QString errorString() const;
+
+    static QString cachePath(QString sFileName);
+    static bool parseObj(const QByteArray& text, MeshData* pMesh);
+    static bool parseStl(const QByteArray& data, MeshData* pMesh);
+    static void weld(MeshData* pMesh);
+    static void optimize(MeshData* pMesh, int cacheSize);
+    static void normalize(MeshData* pMesh);
+    static double acmr(const QVector<quint32>& indices, int cacheSize);
+
+protected:
+    bool mapCache(QString sCacheName, qint64 sourceSize, qint64 sourceModified);
+    bool writeCache(QString sCacheName, const MeshData& mesh,
+                    qint64 sourceSize, qint64 sourceModified);
+
+protected:
+    QFile*   pCacheFile;
+    uchar*   pMapped;
+    MeshData converted;  // Used when the cache cannot be written
+    const MeshVertex* pVertices;
+    const void* pIndices;
+    int      nVertices;
+    int      nIndices;
+    int      iIndexSize;
+    QString  sReport;
+    QString  sError;
+};
@@ -0,0 +1,115 @@
+/*
+ *
+Copyright (C) 2016  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include "minmaxpyramid.h"
+
+
+MinMaxPyramid::MinMaxPyramid(int capacity) {
+    setCapacity(capacity);
+    clear();
+}
+
+
+void
+MinMaxPyramid::setCapacity(int capacity) {
+    // Two spare slots for the buckets straddling the window ends
+    for(int l=0; l<nLevels; l++)
+        levels[l].setCapacity(capacity/bucketSize(l) + 2);
+}
+
+
+void
+MinMaxPyramid::clear() {
+    for(int l=0; l<nLevels; l++) {
+        levels[l].clear();
+        partial[l].count = 0;
+    }
+}
+
+
+int
+MinMaxPyramid::bucketSize(int level) {
+    return 1 << (2*(level+1));
+}
+
+
+const RingBuffer<LodBucket>&
+MinMaxPyramid::buckets(int level) const {
+    return levels[level];
+}
+
+
+void
+MinMaxPyramid::merge(LodBucket& into, const LodBucket& from) {
+    if(into.count == 0) {
+        into = from;
+        return;
+    }
+    into.count += from.count;
+    into.xLast  = from.xLast;
+    into.yLast  = from.yLast;
+    if(from.yMin < into.yMin) {
+        into.xMin = from.xMin;
+        into.yMin = from.yMin;
+    }
+    if(from.yMax > into.yMax) {
+        into.xMax = from.xMax;
+        into.yMax = from.yMax;
+    }
+}
+
+
+void
+MinMaxPyramid::append(quint64 seq, double x, double y) {
+    LodBucket carry;
+    carry.firstSeq = seq;
+    carry.count    = 1;
+    carry.xFirst = carry.xLast = carry.xMin = carry.xMax = x;
+    carry.yFirst = carry.yLast = carry.yMin = carry.yMax = y;
+    // Each completed bucket is carried to the next level
+    for(int l=0; l<nLevels; l++) {
+        merge(partial[l], carry);
+        if(partial[l].count < bucketSize(l))
+            return;
+        levels[l].append(partial[l]);
+        carry = partial[l];
+        partial[l].count = 0;
+    }
+}
+
+
+void
+MinMaxPyramid::evict(quint64 oldestSeq) {
+    for(int l=0; l<nLevels; l++) {
+        while(!levels[l].isEmpty() && levels[l].first().firstSeq < oldestSeq)
+            levels[l].removeFirst();
+    }
+}
+
+
+// Coarsest level whose buckets do not exceed the given size, or -1
+// when even the finest level is too coarse (use the raw samples).
+int
+MinMaxPyramid::levelFor(double maxSamplesPerBucket) const {
+    int iLevel = -1;
+    for(int l=0; l<nLevels; l++) {
+        if(double(bucketSize(l)) > maxSamplesPerBucket) break;
+        iLevel = l;
+    }
+    return iLevel;
+}
@@ -0,0 +1,64 @@
+/*
+ *
+Copyright (C) 2016  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QtGlobal>
+
+#include "ringbuffer.h"
+
+
+// Summary of a run of consecutive samples: enough to redraw the
+// run as a polyline (first, min, max, last) without losing spikes.
+struct LodBucket {
+    quint64 firstSeq;
+    int     count;
+    double  xFirst, yFirst;
+    double  xLast,  yLast;
+    double  xMin,   yMin;
+    double  xMax,   yMax;
+};
+
+
+// Multi resolution min/max decimation of a sliding window of samples.
+// Level l groups bucketSize(l) = 4^(l+1) consecutive samples; levels
+// are built incrementally on append and the buckets whose first sample
+// left the window are dropped, so every stored bucket is complete.
+class MinMaxPyramid
+{
+public:
+    static const int nLevels   = 8;
+    static const int branching = 4;
+
+public:
+    explicit MinMaxPyramid(int capacity=0);
+    void setCapacity(int capacity);
+    void clear();
+    void append(quint64 seq, double x, double y);
+    void evict(quint64 oldestSeq);
+    int  levelFor(double maxSamplesPerBucket) const;
+    static int bucketSize(int level);
+    const RingBuffer<LodBucket>& buckets(int level) const;
+
+protected:
+    static void merge(LodBucket& into, const LodBucket& from);
+
+protected:
+    RingBuffer<LodBucket> levels[nLevels];
+    LodBucket partial[nLevels]; // Bucket being filled (count==0 if empty)
+};
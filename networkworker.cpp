@@ -0,0 +1,447 @@
+/*
+ *
+Copyright (C) 2016  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include "networkworker.h"
+#include "utilities.h"
+
+#include <QTcpSocket>
+#include <QUdpSocket>
+#include <QSocketNotifier>
+
+#if defined(Q_OS_LINUX)
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#endif
+
+
+// Datagrams received with a single recvmmsg() call
+#define UDP_BATCH_SIZE      64
+#define UDP_DATAGRAM_SIZE   2048
+
+
+#if defined(Q_OS_LINUX)
+struct UdpBatch
+{
+    int      fd;
+    QByteArray slab; // UDP_BATCH_SIZE slots of UDP_DATAGRAM_SIZE bytes
+    mmsghdr  messages[UDP_BATCH_SIZE];
+    iovec    buffers[UDP_BATCH_SIZE];
+};
+#else
+struct UdpBatch
+{
+    int fd;
+};
+#endif
+
+
+NetworkWorker::NetworkWorker(int udpPort, QObject *parent)
+    : QObject(parent)
+    , pTcpSocket(nullptr)
+    , pUdpSocket(nullptr)
+    , udpPort(udpPort)
+    , bBatchReceive(true)
+    , pUdpBatch(nullptr)
+    , pUdpNotifier(nullptr)
+    , samples(16384)
+    , iMaxDepth(0)
+    , nDropped(0)
+    , bSamplesSignaled(0)
+    , bFlushScheduled(false)
+{
+    sentOrders.nSent      = 0;
+    sentOrders.nCoalesced = 0;
+}
+
+
+NetworkWorker::~NetworkWorker() {
+    closeBatchSocket();
+}
+
+
+// To be called before start()
+void
+NetworkWorker::setBatchReceive(bool bEnable) {
+    bBatchReceive = bEnable;
+}
+
+
+bool
+NetworkWorker::isBatchReceive() const {
+    return pUdpBatch != nullptr;
+}
+
+
+// The sockets must be created in the worker thread
+void
+NetworkWorker::start() {
+    pTcpSocket = new QTcpSocket(this);
+    pUdpSocket = new QUdpSocket(this);
+    connect(pTcpSocket, SIGNAL(connected()),
+            this, SLOT(onTcpConnected()));
+    connect(pTcpSocket, SIGNAL(bytesWritten(qint64)),
+            this, SLOT(onBytesWritten(qint64)));
+    connect(pTcpSocket, SIGNAL(disconnected()),
+            this, SIGNAL(disconnected()));
+    connect(pTcpSocket, SIGNAL(readyRead()),
+            this, SLOT(onTcpReadyRead()));
+    connect(pTcpSocket, SIGNAL(error(QAbstractSocket::SocketError)),
+            this, SLOT(onTcpError(QAbstractSocket::SocketError)));
+    if(bBatchReceive && openBatchSocket())
+        return;
+    if(!pUdpSocket->bind(QHostAddress::Any, quint16(udpPort))) {
+        emit udpBindFailed();
+        return;
+    }
+    connect(pUdpSocket, SIGNAL(readyRead()),
+            this, SLOT(onUdpReadyRead()));
+}
+
+
+void
+NetworkWorker::stop() {
+    if(pTcpSocket) pTcpSocket->close();
+    if(pUdpSocket) pUdpSocket->close();
+    closeBatchSocket();
+    recorder.stop();
+}
+
+
+void
+NetworkWorker::startRecording(QString sBasePath) {
+    bool bOk = recorder.start(sBasePath);
+    emit recordingStarted(bOk, sBasePath);
+}
+
+
+void
+NetworkWorker::stopRecording() {
+    recorder.stop();
+    emit recordingStopped(recorder.recordedMessages());
+}
+
+
+// Every decoded message is logged with its socket read time
+void
+NetworkWorker::record(quint64 readMicros, const char* pFrame, int nBytes) {
+    if(!recorder.isRecording()) return;
+    recorder.record(readMicros, pFrame, nBytes);
+    if(!recorder.isRecording()) // No room for a new segment
+        emit recordingStopped(recorder.recordedMessages());
+}
+
+
+bool
+NetworkWorker::openBatchSocket() {
+#if defined(Q_OS_LINUX)
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(fd < 0) return false;
+    int iOn = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &iOn, sizeof(iOn));
+    int iBufferSize = 4*1024*1024; // Room for the bursts
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &iBufferSize, sizeof(iBufferSize));
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family      = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port        = htons(quint16(udpPort));
+    if(bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        ::close(fd);
+        return false;
+    }
+    pUdpBatch = new UdpBatch;
+    pUdpBatch->fd = fd;
+    pUdpBatch->slab.resize(UDP_BATCH_SIZE*UDP_DATAGRAM_SIZE);
+    memset(pUdpBatch->messages, 0, sizeof(pUdpBatch->messages));
+    for(int i=0; i<UDP_BATCH_SIZE; i++) {
+        pUdpBatch->buffers[i].iov_base = pUdpBatch->slab.data()+i*UDP_DATAGRAM_SIZE;
+        pUdpBatch->buffers[i].iov_len  = UDP_DATAGRAM_SIZE;
+        pUdpBatch->messages[i].msg_hdr.msg_iov    = &pUdpBatch->buffers[i];
+        pUdpBatch->messages[i].msg_hdr.msg_iovlen = 1;
+    }
+    pUdpNotifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+    connect(pUdpNotifier, SIGNAL(activated(int)),
+            this, SLOT(onUdpBatchReadyRead()));
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+void
+NetworkWorker::closeBatchSocket() {
+    if(pUdpNotifier) {
+        delete pUdpNotifier;
+        pUdpNotifier = nullptr;
+    }
+    if(pUdpBatch) {
+#if defined(Q_OS_LINUX)
+        ::close(pUdpBatch->fd);
+#endif
+        delete pUdpBatch;
+        pUdpBatch = nullptr;
+    }
+}
+
+
+// Drains the socket UDP_BATCH_SIZE datagrams per system call
+void
+NetworkWorker::onUdpBatchReadyRead() {
+#if defined(Q_OS_LINUX)
+    for(;;) {
+        int nReceived = recvmmsg(pUdpBatch->fd, pUdpBatch->messages, UDP_BATCH_SIZE,
+                                 MSG_DONTWAIT, nullptr);
+        if(nReceived <= 0) break; // EAGAIN: nothing more to read
+        quint64 readMicros = micros();
+        const char* pSlab = pUdpBatch->slab.constData();
+        for(int i=0; i<nReceived; i++) {
+            int nBytes = int(pUdpBatch->messages[i].msg_len);
+            if(pUdpBatch->messages[i].msg_hdr.msg_flags & MSG_TRUNC) continue;
+            processDatagram(pSlab+i*UDP_DATAGRAM_SIZE, nBytes, readMicros);
+        }
+        if(nReceived < UDP_BATCH_SIZE) break;
+    }
+#endif
+}
+
+
+void
+NetworkWorker::connectToRobot(QHostAddress address, quint16 port) {
+    tcpFramer.clear();
+    orders.clear();
+    pTcpSocket->connectToHost(address, port);
+}
+
+
+void
+NetworkWorker::disconnectFromRobot() {
+    pTcpSocket->close();
+}
+
+
+// The small orders must not wait for Nagle
+void
+NetworkWorker::onTcpConnected() {
+    pTcpSocket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    emit connected();
+}
+
+
+// The write is deferred after the send() calls already queued, so that
+// only the newest of them reaches the Robot
+void
+NetworkWorker::send(QByteArray message, quint64 queuedMicros) {
+    if(!pTcpSocket->isOpen()) return;
+    orders.enqueue(message, queuedMicros);
+    if(!bFlushScheduled) {
+        bFlushScheduled = true;
+        QMetaObject::invokeMethod(this, "flushOrders", Qt::QueuedConnection);
+    }
+}
+
+
+// While the socket still holds unsent bytes the orders keep waiting
+// (and coalescing): the next bytesWritten() flushes them
+void
+NetworkWorker::flushOrders() {
+    bFlushScheduled = false;
+    if(!pTcpSocket->isOpen()) {
+        orders.clear();
+        return;
+    }
+    if(pTcpSocket->bytesToWrite() > 0) return;
+    QByteArray order;
+    quint64 queuedMicros;
+    quint64 nWritten = 0;
+    while(orders.next(&order, &queuedMicros)) {
+        pTcpSocket->write(order);
+        pTcpSocket->flush();
+        quint64 now = micros();
+        QMutexLocker locker(&orderMutex);
+        sentOrders.latency[CommandScheduler::orderKind(order)]
+                .record(now > queuedMicros ? now-queuedMicros : 0);
+        nWritten++;
+        if(pTcpSocket->bytesToWrite() > 0) break; // Kernel buffer full
+    }
+    QMutexLocker locker(&orderMutex);
+    sentOrders.nSent += nWritten;
+    sentOrders.nCoalesced = orders.coalesced();
+}
+
+
+void
+NetworkWorker::onBytesWritten(qint64 nBytes) {
+    Q_UNUSED(nBytes)
+    if(!orders.isEmpty() && pTcpSocket->bytesToWrite() == 0)
+        flushOrders();
+}
+
+
+void
+NetworkWorker::onTcpError(QAbstractSocket::SocketError socketError) {
+    QString sError = pTcpSocket->errorString();
+    pTcpSocket->close();
+    emit socketError(int(socketError), sError);
+}
+
+
+void
+NetworkWorker::onTcpReadyRead() {
+    tcpFramer.readFrom(pTcpSocket);
+    quint64 readMicros = micros();
+    const char* pFrame;
+    int nBytes;
+    TelemetryMessage command;
+    while(tcpFramer.nextFrame(&pFrame, &nBytes)) {
+        DecodeTelemetry(pFrame, nBytes, &command);
+        dispatch(&command, pFrame, nBytes, readMicros);
+    }
+}
+
+
+void
+NetworkWorker::onUdpReadyRead() {
+    while(pUdpSocket->hasPendingDatagrams()) {
+        qint64 nSize = pUdpSocket->pendingDatagramSize();
+        if(nSize < 0) break;
+        if(datagram.size() < nSize) datagram.resize(int(nSize));
+        qint64 nRead = pUdpSocket->readDatagram(datagram.data(), nSize);
+        if(nRead > 0)
+            processDatagram(datagram.constData(), int(nRead), micros());
+    }
+}
+
+
+// A datagram may hold several messages, the first one may be the
+// sequence number used for the link statistics
+void
+NetworkWorker::processDatagram(const char* pData, int nBytes, quint64 readMicros) {
+    TelemetryMessage command;
+    int nUsed = DecodeTelemetry(pData, nBytes, &command);
+    if(nUsed > 0 && command.type == TELEMETRY_SEQUENCE && command.nValues == 2) {
+        record(readMicros, pData, nUsed);
+        QMutexLocker locker(&statsMutex);
+        linkStatistics.addPacket(quint32(command.value[0]),
+                                 quint64(command.value[1]),
+                                 readMicros);
+        pData  += nUsed;
+        nBytes -= nUsed;
+    }
+    while(nBytes > 0 && (nUsed = DecodeTelemetry(pData, nBytes, &command)) > 0) {
+        dispatch(&command, pData, nUsed, readMicros);
+        pData  += nUsed;
+        nBytes -= nUsed;
+    }
+}
+
+
+// The message is already decoded from the frame bytes, which are
+// still needed for the recording and the rare messages
+void
+NetworkWorker::dispatch(TelemetryMessage* pCommand, const char* pFrame, int nBytes, quint64 readMicros) {
+    TelemetryMessage& command = *pCommand;
+    command.readMicros   = readMicros;
+    command.parsedMicros = micros();
+    if(command.type)
+        record(readMicros, pFrame, nBytes);
+    if(command.type == 'q' || command.type == 'p' || command.type == 'r') {
+        command.pText = nullptr; // Not valid outside this call
+        command.nTextLength = 0;
+        if(!samples.push(command)) {
+            nDropped.fetchAndAddRelaxed(1);
+            return;
+        }
+        int iDepth = samples.count();
+        if(iDepth > iMaxDepth.loadRelaxed())
+            iMaxDepth.storeRelaxed(iDepth);
+        // One queued signal wakes the GUI for the whole batch
+        if(!bSamplesSignaled.fetchAndStoreOrdered(1))
+            emit samplesAvailable();
+    }
+    else if(command.type) {
+        emit messageReceived(QByteArray(pFrame, nBytes));
+    }
+}
+
+
+// GUI thread
+bool
+NetworkWorker::popSample(TelemetryMessage* pSample) {
+    return samples.pop(pSample);
+}
+
+
+// GUI thread: to be called before draining the queue, so that the
+// samples pushed meanwhile signal again
+void
+NetworkWorker::armSamplesAvailable() {
+    bSamplesSignaled.storeRelease(0);
+}
+
+
+int
+NetworkWorker::queueDepth() const {
+    return samples.count();
+}
+
+
+int
+NetworkWorker::maxQueueDepth() const {
+    return iMaxDepth.loadRelaxed();
+}
+
+
+quint64
+NetworkWorker::droppedSamples() const {
+    return nDropped.loadRelaxed();
+}
+
+
+LinkStats
+NetworkWorker::linkStats() {
+    QMutexLocker locker(&statsMutex);
+    return linkStatistics.stats();
+}
+
+
+void
+NetworkWorker::resetLinkStats() {
+    QMutexLocker locker(&statsMutex);
+    linkStatistics.clear();
+}
+
+
+OrderStats
+NetworkWorker::orderStats() {
+    QMutexLocker locker(&orderMutex);
+    return sentOrders;
+}
+
+
+// The counts are kept: they are shown in the status bar
+void
+NetworkWorker::resetOrderLatency() {
+    QMutexLocker locker(&orderMutex);
+    for(int i=0; i<nOrderKinds; i++)
+        sentOrders.latency[i].clear();
+}
@@ -0,0 +1,130 @@
+/*
+ *
+Copyright (C) 2016  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QObject>
+#include <QHostAddress>
+#include <QAbstractSocket>
+#include <QAtomicInteger>
+#include <QMutex>
+
+#include "spscqueue.h"
+#include "streamframer.h"
+#include "telemetryprotocol.h"
+#include "linkstatistics.h"
+#include "telemetryrecorder.h"
+#include "commandscheduler.h"
+
+
+QT_FORWARD_DECLARE_CLASS(QTcpSocket)
+QT_FORWARD_DECLARE_CLASS(QUdpSocket)
+QT_FORWARD_DECLARE_CLASS(QSocketNotifier)
+QT_FORWARD_DECLARE_STRUCT(UdpBatch)
+
+
+// Owns the Robot sockets and runs on its own thread (see moveToThread()).
+// The telemetry samples ('q', 'p' and 'r' messages) are decoded here and
+// handed to the GUI thread through a lock free queue that the GUI drains
+// once per frame; the rare messages are sent as a queued signal instead.
+// Every method but the slots may be called from the GUI thread.
+// On Linux the UDP datagrams are received in batches with recvmmsg()
+// into a preallocated slab (see setBatchReceive()); elsewhere, or if
+// that socket cannot be opened, the QUdpSocket path is used.
+// The samples carry the time of the socket read and of their decoding
+// (see micros()) for the latency measures of the GUI.
+// The orders to the Robot go through a CommandScheduler: they are written
+// with TCP_NODELAY once the events already queued to the worker are
+// processed, so that a burst of Move or PID orders leaves as one.
+class NetworkWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit NetworkWorker(int udpPort, QObject *parent = nullptr);
+    ~NetworkWorker();
+
+    void setBatchReceive(bool bEnable);
+    bool isBatchReceive() const;
+
+    bool popSample(TelemetryMessage* pSample);
+    void armSamplesAvailable();
+    int  queueDepth() const;
+    int  maxQueueDepth() const;
+    quint64 droppedSamples() const;
+    LinkStats linkStats();
+    void resetLinkStats();
+    OrderStats orderStats();
+    void resetOrderLatency();
+
+signals:
+    void connected();
+    void disconnected();
+    void socketError(int error, QString sError);
+    void udpBindFailed();
+    void messageReceived(QByteArray message);
+    void samplesAvailable(); // Once until armSamplesAvailable()
+    void recordingStarted(bool bOk, QString sBasePath);
+    void recordingStopped(quint64 nMessages);
+
+public slots:
+    void start();
+    void stop();
+    void connectToRobot(QHostAddress address, quint16 port);
+    void disconnectFromRobot();
+    void send(QByteArray message, quint64 queuedMicros);
+    void startRecording(QString sBasePath);
+    void stopRecording();
+
+protected slots:
+    void onTcpConnected();
+    void onTcpReadyRead();
+    void onBytesWritten(qint64 nBytes);
+    void flushOrders();
+    void onUdpReadyRead();
+    void onUdpBatchReadyRead();
+    void onTcpError(QAbstractSocket::SocketError socketError);
+
+protected:
+    bool openBatchSocket();
+    void closeBatchSocket();
+    void processDatagram(const char* pData, int nBytes, quint64 readMicros);
+    void dispatch(TelemetryMessage* pCommand, const char* pFrame, int nBytes, quint64 readMicros);
+    void record(quint64 readMicros, const char* pFrame, int nBytes);
+
+protected:
+    QTcpSocket*  pTcpSocket;
+    QUdpSocket*  pUdpSocket;
+    int          udpPort;
+    StreamFramer tcpFramer;
+    QByteArray   datagram;
+    bool         bBatchReceive;
+    UdpBatch*    pUdpBatch;
+    QSocketNotifier* pUdpNotifier;
+    SpscQueue<TelemetryMessage> samples;
+    QAtomicInteger<int>     iMaxDepth;
+    QAtomicInteger<quint64> nDropped;
+    QAtomicInteger<int>     bSamplesSignaled;
+    QMutex         statsMutex;
+    LinkStatistics linkStatistics;
+    TelemetryRecorder recorder;
+    CommandScheduler  orders;
+    bool              bFlushScheduled;
+    QMutex            orderMutex;
+    OrderStats        sentOrders;
+};
@@ -18,6 +18,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "plot2d.h"
 #include "axesdialog.h"
+#include "plotgllayer.h"
 
 #include <float.h>
 #include <math.h>
@@ -26,6 +27,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <QCloseEvent>
 #include <QDebug>
 #include <QIcon>
+#include <QtNumeric>
+#include <string.h>
 
 
 Plot2D::Plot2D(QWidget *parent, QString Title)
@@ -45,10 +48,24 @@ Plot2D::Plot2D(QWidget *parent, QString Title)
     yMarker      = 0.0;
     bShowMarker  = false;
     bZooming     = false;
+    bBackgroundDirty = true;
+    cachedXfact  = 1.0;
+    cachedYfact  = 1.0;
+    bStripChart  = false;
+    stripSpan    = 1.0;
+    bStripAutoX  = false;
+    bStripLogX   = false;
+    bDataLayerDirty = true;
+    stripXMin    = 0.0;
+    stripXfact   = 1.0;
+    stripYfact   = 1.0;
+    iDrawFrom    = 0;
+    pGLLayer     = nullptr;
+    renderDpr    = 1.0;
 
     pPropertiesDlg = new plotPropertiesDlg(sTitle);
     connect(pPropertiesDlg, SIGNAL(configChanged()),
-            this, SLOT(UpdatePlot()));
+            this, SLOT(onConfigChanged()));
 
     labelPen = pPropertiesDlg->labelColor;//QPen(Qt::white);
     gridPen  = pPropertiesDlg->gridColor; //QPen(Qt::blue);
@@ -76,11 +93,24 @@ Plot2D::~Plot2D() {
 void
 Plot2D::setTitle(QString sNewTitle) {
     sTitle = sNewTitle;
+    bBackgroundDirty = true;
 }
 
 
 void
 Plot2D::keyPressEvent(QKeyEvent *e) {
+    // 'S' toggles the strip chart mode keeping the current X span
+    if(e->key() == Qt::Key_S) {
+        SetStripChart(!bStripChart, Ax.XMax-Ax.XMin);
+        update();
+        return;
+    }
+    // 'G' toggles the OpenGL backend
+    if(e->key() == Qt::Key_G) {
+        SetOpenGL(!IsOpenGL());
+        update();
+        return;
+    }
     // To avoid closing the Plot upon Esc keypress
     if(e->key() != Qt::Key_Escape)
         QWidget::keyPressEvent(e);
@@ -97,18 +127,110 @@ Plot2D::closeEvent(QCloseEvent *event) {
 
 void
 Plot2D::paintEvent(QPaintEvent *event) {
+    Q_UNUSED(event)
+    if(pGLLayer) return; // It covers the whole plot
     QPainter painter;
     painter.begin(this);
-    painter.setFont(pPropertiesDlg->painterFont);
-    QFontMetrics fontMetrics = painter.fontMetrics();
-    painter.fillRect(event->rect(), QBrush(pPropertiesDlg->painterBkColor));
-    DrawPlot(&painter, fontMetrics);
+    PaintPlot(&painter);
+    painter.end();
+    emit framePainted();
+}
+
+
+// Shared by the QPainter and the OpenGL backends
+void
+Plot2D::PaintPlot(QPainter* painter) {
+    painter->setFont(pPropertiesDlg->painterFont);
+    QFontMetrics fontMetrics = painter->fontMetrics();
+    DrawPlot(painter, fontMetrics);
+    // The images must not depend on where the mouse was
+    if(renderSize.isValid()) return;
     QRect textSize = fontMetrics.boundingRect(sMouseCoord);
-    int nPosX = (width()/2) - (textSize.width()/2);
-    int nPosY = height() - 4;
-    painter.setPen(labelPen);
-    painter.drawText(nPosX, nPosY, sMouseCoord);
+    int nPosX = (PaintSize().width()/2) - (textSize.width()/2);
+    int nPosY = PaintSize().height() - 4;
+    painter->setPen(labelPen);
+    painter->drawText(nPosX, nPosY, sMouseCoord);
+}
+
+
+// Size of the surface being painted: the widget or the image
+QSize
+Plot2D::PaintSize() const {
+    return renderSize.isValid() ? renderSize : size();
+}
+
+
+qreal
+Plot2D::PaintDpr() const {
+    return renderSize.isValid() ? renderDpr : devicePixelRatioF();
+}
+
+
+// The whole plot (frame, ticks and Data Sets) drawn into an image of
+// any size, with the QPainter backend. The widget need not be shown
+// (i.e. it works with QT_QPA_PLATFORM=offscreen): for the benchmarks,
+// the golden image comparisons and the batch exports.
+QImage
+Plot2D::renderToImage(QSize imageSize, qreal dpr) {
+    QImage image(imageSize*dpr, QImage::Format_ARGB32_Premultiplied);
+    image.setDevicePixelRatio(dpr);
+    image.fill(pPropertiesDlg->painterBkColor);
+    // The frame and the scale factors belong to the widget
+    AxisFrame savedFrame = Pf;
+    double savedXfact = xfact, savedYfact = yfact;
+    renderSize = imageSize;
+    renderDpr  = dpr;
+    // The cached layers are rebuilt for the image, then for the widget
+    bBackgroundDirty = true;
+    bDataLayerDirty  = true;
+    QPainter painter(&image);
+    PaintPlot(&painter);
     painter.end();
+    renderSize = QSize();
+    Pf    = savedFrame;
+    xfact = savedXfact;
+    yfact = savedYfact;
+    bBackgroundDirty = true;
+    bDataLayerDirty  = true;
+    update();
+    return image;
+}
+
+
+bool
+Plot2D::exportImage(QString sFileName, QSize imageSize, qreal dpr) {
+    return renderToImage(imageSize, dpr).save(sFileName);
+}
+
+
+void
+Plot2D::resizeEvent(QResizeEvent *event) {
+    if(pGLLayer) pGLLayer->setGeometry(rect());
+    QWidget::resizeEvent(event);
+}
+
+
+// The OpenGL backend draws the Data Sets from vertex buffers; frame,
+// labels and titles are still drawn by this widget's code
+void
+Plot2D::SetOpenGL(bool bEnable) {
+    if(bEnable == IsOpenGL()) return;
+    if(bEnable) {
+        pGLLayer = new PlotGLLayer(this);
+        pGLLayer->setGeometry(rect());
+        pGLLayer->show();
+    }
+    else {
+        delete pGLLayer;
+        pGLLayer = nullptr;
+    }
+    bDataLayerDirty = true;
+}
+
+
+bool
+Plot2D::IsOpenGL() {
+    return pGLLayer != nullptr;
 }
 
 
@@ -130,6 +252,33 @@ Plot2D::setMaxPoints(int nPoints) {
     for(int pos=0; pos<dataSetList.count(); pos++) {
         dataSetList.at(pos)->setMaxPoints(pPropertiesDlg->maxDataPoints);
     }
+    bDataLayerDirty = true;
+}
+
+
+// In strip chart mode the X axis always shows the last xSpan units of
+// the shown Data Sets and the data layer is scrolled instead of being
+// redrawn: only the points arrived since the previous frame are drawn.
+void
+Plot2D::SetStripChart(bool bEnable, double xSpan) {
+    if(xSpan > 0.0) stripSpan = xSpan;
+    if(bEnable == bStripChart) return;
+    bStripChart = bEnable;
+    if(bStripChart) {
+        bStripAutoX = Ax.AutoX;
+        bStripLogX  = Ax.LogX;
+    }
+    else {
+        Ax.AutoX = bStripAutoX;
+        Ax.LogX  = bStripLogX;
+    }
+    bDataLayerDirty = true;
+}
+
+
+bool
+Plot2D::IsStripChart() {
+    return bStripChart;
 }
 
 
@@ -238,34 +387,56 @@ Plot2D::NewDataSet(int Id, int PenWidth, QColor Color, int Symbol, QString Title
     DataStream2D* pDataItem = new DataStream2D(Id, PenWidth, Color, Symbol, Title);
     pDataItem->setMaxPoints(pPropertiesDlg->maxDataPoints);
     dataSetList.append(pDataItem);
+    bDataLayerDirty = true;
+    if(!dataSetIndex.contains(Id))
+        dataSetIndex.insert(Id, pDataItem);
     return pDataItem;
 }
 
 
+DataStream2D*
+Plot2D::FindDataSet(int Id) {
+    return dataSetIndex.value(Id, Q_NULLPTR);
+}
+
+
 bool
-Plot2D::ClearDataSet(int Id) {
-    bool bResult = false;
-    for(int i=0; i<dataSetList.count(); i++) {
-        DataStream2D* pDataItem = dataSetList.at(i);
-        if(pDataItem->GetId() == Id) {
-            pDataItem->RemoveAllPoints();
-            bResult = true;
+Plot2D::DelDataSet(int Id) {
+    DataStream2D* pData = FindDataSet(Id);
+    if(!pData) return false;
+    dataSetIndex.remove(Id);
+    dataSetList.removeOne(pData);
+    stripDrawnSeq.remove(pData);
+    if(pGLLayer) pGLLayer->forgetStream(pData);
+    delete pData;
+    bDataLayerDirty = true;
+    // Another Data Set could share the same Id
+    for(int pos=0; pos<dataSetList.count(); pos++) {
+        if(dataSetList.at(pos)->GetId() == Id) {
+            dataSetIndex.insert(Id, dataSetList.at(pos));
+            break;
         }
     }
-    return bResult;
+    return true;
+}
+
+
+bool
+Plot2D::ClearDataSet(int Id) {
+    DataStream2D* pData = FindDataSet(Id);
+    if(!pData) return false;
+    pData->RemoveAllPoints();
+    bDataLayerDirty = true;
+    return true;
 }
 
 
 void
 Plot2D::SetShowDataSet(int Id, bool Show) {
-    if(!dataSetList.isEmpty()) {
-        for(int pos=0; pos<dataSetList.count(); pos++) {
-            DataStream2D* pData = dataSetList.at(pos);
-            if(pData->GetId() == Id) {
-                pData->SetShow(Show);
-                break;
-            }
-        }
+    DataStream2D* pData = FindDataSet(Id);
+    if(pData) {
+        pData->SetShow(Show);
+        bDataLayerDirty = true;
     }
 }
 
@@ -273,20 +444,46 @@ Plot2D::SetShowDataSet(int Id, bool Show) {
 void
 Plot2D::NewPoint(int Id, double x, double y) {
     if(std::isnan(y)) return;
-    if(dataSetList.isEmpty())  return;
-    DataStream2D* pData = Q_NULLPTR;
-    for(int pos=0; pos<dataSetList.count(); pos++) {
-        if(dataSetList.at(pos)->GetId() == Id) {
-            pData = dataSetList.at(pos);
-            break;
-        }
-    }
+    DataStream2D* pData = FindDataSet(Id);
     if(pData) {
         pData->AddPoint(x, y);
     }
 }
 
 
+// Adds a run of samples to a single Data Set
+void
+Plot2D::NewPoints(int Id, const double* x, const double* y, int n) {
+    DataStream2D* pData = FindDataSet(Id);
+    if(!pData || n <= 0) return;
+    int iFirstNan = 0;
+    while(iFirstNan < n && !std::isnan(y[iFirstNan])) iFirstNan++;
+    if(iFirstNan == n) {
+        pData->AddPoints(x, y, n);
+        return;
+    }
+    // NaN samples are discarded as in NewPoint()
+    bulkX.resize(0);
+    bulkY.resize(0);
+    for(int i=0; i<n; i++) {
+        if(std::isnan(y[i])) continue;
+        bulkX.append(x[i]);
+        bulkY.append(y[i]);
+    }
+    pData->AddPoints(bulkX.constData(), bulkY.constData(), bulkX.count());
+}
+
+
+// Adds n samples sharing the same x column to nColumns Data Sets:
+// y[j] holds the values for the Data Set Ids[j].
+void
+Plot2D::NewPoints(const double* x, int n, const int* Ids, const double* const* y, int nColumns) {
+    for(int j=0; j<nColumns; j++) {
+        NewPoints(Ids[j], x, y[j], n);
+    }
+}
+
+
 void
 Plot2D::DrawData(QPainter* painter, QFontMetrics fontMetrics) {
     if(dataSetList.isEmpty()) return;
@@ -308,15 +505,34 @@ Plot2D::DrawData(QPainter* painter, QFontMetrics fontMetrics) {
 
 
 void
-Plot2D::SetShowTitle(int Id, bool show) {
-    if(dataSetList.isEmpty()) return;
-    DataStream2D* pData;
+Plot2D::DrawGLData(QPainter* painter, QFontMetrics fontMetrics) {
+    if(!pGLLayer->isReady()) {
+        DrawData(painter, fontMetrics);
+        return;
+    }
+    PlotTransform t = CurrentTransform();
+    painter->beginNativePainting();
+    pGLLayer->beginData(QRectF(Pf.left, Pf.top, Pf.right-Pf.left, Pf.bottom-Pf.top));
     for(int pos=0; pos<dataSetList.count(); pos++) {
-        pData = dataSetList.at(pos);
-        if(pData->GetId() == Id) {
-            pData->SetShowTitle(show);
-            return;
-        }
+        DataStream2D* pData = dataSetList.at(pos);
+        if(pData->isShown)
+            pGLLayer->drawStream(pData, t);
+    }
+    pGLLayer->endData();
+    painter->endNativePainting();
+    for(int pos=0; pos<dataSetList.count(); pos++) {
+        DataStream2D* pData = dataSetList.at(pos);
+        if(pData->isShown && pData->bShowCurveTitle)
+            ShowTitle(painter, fontMetrics, pData);
+    }
+}
+
+
+void
+Plot2D::SetShowTitle(int Id, bool show) {
+    DataStream2D* pData = FindDataSet(Id);
+    if(pData) {
+        pData->SetShowTitle(show);
     }
 }
 
@@ -639,23 +855,36 @@ Plot2D::DrawFrame(QPainter* painter, QFontMetrics fontMetrics) {
 
     painter->setPen(labelPen);
     int icx = fontMetrics.horizontalAdvance((sTitle));
-    painter->drawText(QPoint(int((width()-icx)/2), int(fontMetrics.height())), sTitle);
+    painter->drawText(QPoint(int((PaintSize().width()-icx)/2), int(fontMetrics.height())), sTitle);
 }
 
 
 void
 Plot2D::DrawPlot(QPainter* painter, QFontMetrics fontMetrics) {
-    if(Ax.AutoX || Ax.AutoY) {
+    if(bStripChart) {
+        double xNewest;
+        if(NewestX(&xNewest)) {
+            Ax.XMin = xNewest - stripSpan;
+            Ax.XMax = xNewest;
+        }
+        SetLimits (Ax.XMin, Ax.XMax, Ax.YMin, Ax.YMax, false, Ax.AutoY, false, Ax.LogY);
+    }
+    else if(Ax.AutoX || Ax.AutoY) {
         SetLimits (Ax.XMin, Ax.XMax, Ax.YMin, Ax.YMax, Ax.AutoX, Ax.AutoY, Ax.LogX, Ax.LogY);
     }
 
     Pf.left = fontMetrics.horizontalAdvance("-0.00000") + 2.0;
-    Pf.right = width() - fontMetrics.horizontalAdvance("x10-999") - 5.0;
+    Pf.right = PaintSize().width() - fontMetrics.horizontalAdvance("x10-999") - 5.0;
     Pf.top = 2.0 * fontMetrics.height();
-    Pf.bottom = height() - 3.0*fontMetrics.height();
+    Pf.bottom = PaintSize().height() - 3.0*fontMetrics.height();
 
-    DrawFrame(painter, fontMetrics);
-    DrawData(painter, fontMetrics);
+    DrawBackground(painter, fontMetrics);
+    if(pGLLayer && painter->device() == pGLLayer)
+        DrawGLData(painter, fontMetrics);
+    else if(bStripChart)
+        DrawStripData(painter, fontMetrics);
+    else
+        DrawData(painter, fontMetrics);
     if(bZooming) {
         QPen zoomPen(Qt::yellow);
         painter->setPen(zoomPen);
@@ -666,6 +895,174 @@ Plot2D::DrawPlot(QPainter* painter, QFontMetrics fontMetrics) {
 }
 
 
+// Largest x of the shown Data Sets
+bool
+Plot2D::NewestX(double* xNewest) {
+    bool bFound = false;
+    for(int pos=0; pos<dataSetList.count(); pos++) {
+        DataStream2D* pData = dataSetList.at(pos);
+        if(!pData->isShown || pData->m_pointArrayX.isEmpty()) continue;
+        if(!bFound || pData->maxx > *xNewest) *xNewest = pData->maxx;
+        bFound = true;
+    }
+    return bFound;
+}
+
+
+// Strip chart rendering: the data are kept in an offscreen image of the
+// plot frame that is scrolled by the x distance advanced since the last
+// frame; only the points arrived in the meantime are rasterized.
+// Any other change (size, Y limits, scale, Data Sets) redraws it all.
+void
+Plot2D::DrawStripData(QPainter* painter, QFontMetrics fontMetrics) {
+    qreal dpr = PaintDpr();
+    QSize layerSize(int(ceil((Pf.right-Pf.left+1.0)*dpr)),
+                    int(ceil((Pf.bottom-Pf.top+1.0)*dpr)));
+    bool bRedraw = bDataLayerDirty ||
+                   (dataLayer.size() != layerSize) ||
+                   (dataLayer.devicePixelRatio() != dpr) ||
+                   (Ax.YMin != stripAx.YMin) ||
+                   (Ax.YMax != stripAx.YMax) ||
+                   (Ax.LogY != stripAx.LogY) ||
+                   (fabs(xfact-stripXfact) > 1.0e-9*fabs(xfact)) ||
+                   (yfact != stripYfact);
+    for(int pos=0; pos<dataSetList.count(); pos++) {
+        DataStream2D* pData = dataSetList.at(pos);
+        if(pData->isShown && !pData->IsSortedX()) bRedraw = true;
+    }
+    int iShift = 0;
+    if(!bRedraw) {
+        double shift = (Ax.XMin-stripXMin)*xfact*dpr;
+        if(shift < 0.0 || shift >= dataLayer.width())
+            bRedraw = true;
+        else
+            iShift = qRound(shift);
+    }
+    if(bRedraw) {
+        dataLayer = QImage(layerSize, QImage::Format_ARGB32_Premultiplied);
+        dataLayer.setDevicePixelRatio(dpr);
+        dataLayer.fill(Qt::transparent);
+        stripAx    = Ax;
+        stripXMin  = Ax.XMin;
+        stripXfact = xfact;
+        stripYfact = yfact;
+        stripDrawnSeq.clear();
+        bDataLayerDirty = false;
+    }
+    else if(iShift > 0) {
+        ScrollDataLayer(iShift);
+        stripXMin += iShift/(xfact*dpr);
+    }
+
+    QPainter layerPainter(&dataLayer);
+    // Points that left the Data Set buffers must leave the layer too
+    double xOldest;
+    if(OldestX(&xOldest) && (xOldest > stripXMin)) {
+        layerPainter.setCompositionMode(QPainter::CompositionMode_Clear);
+        layerPainter.fillRect(QRectF(0.0, 0.0, (xOldest-stripXMin)*xfact, dataLayer.height()),
+                              Qt::transparent);
+        layerPainter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+    }
+    // The plot routines draw in widget coordinates
+    layerPainter.translate(-Pf.left+(Ax.XMin-stripXMin)*xfact, -Pf.top);
+    for(int pos=0; pos<dataSetList.count(); pos++) {
+        DataStream2D* pData = dataSetList.at(pos);
+        if(!pData->isShown) continue;
+        quint64 nTotal = pData->GetTotalPoints();
+        quint64 oldestSeq = nTotal-quint64(pData->m_pointArrayX.count());
+        quint64 drawnSeq = stripDrawnSeq.value(pData, 0);
+        if(drawnSeq >= nTotal) continue;
+        // Restart from the last point already drawn to connect the lines
+        iDrawFrom = drawnSeq > oldestSeq ? int(drawnSeq-oldestSeq)-1 : 0;
+        if(pData->GetProperties().Symbol == iline) {
+            LinePlot(&layerPainter, pData);
+        } else if(pData->GetProperties().Symbol == ipoint) {
+            PointPlot(&layerPainter, pData);
+        } else {
+            ScatterPlot(&layerPainter, pData);
+        }
+        stripDrawnSeq.insert(pData, nTotal);
+    }
+    iDrawFrom = 0;
+    layerPainter.end();
+
+    painter->drawImage(QPointF(Pf.left+(stripXMin-Ax.XMin)*xfact, Pf.top), dataLayer);
+    for(int pos=0; pos<dataSetList.count(); pos++) {
+        DataStream2D* pData = dataSetList.at(pos);
+        if(pData->isShown && pData->bShowCurveTitle)
+            ShowTitle(painter, fontMetrics, pData);
+    }
+}
+
+
+// Smallest x still stored in the shown Data Sets
+bool
+Plot2D::OldestX(double* xOldest) {
+    bool bFound = false;
+    for(int pos=0; pos<dataSetList.count(); pos++) {
+        DataStream2D* pData = dataSetList.at(pos);
+        if(!pData->isShown || pData->m_pointArrayX.isEmpty()) continue;
+        if(!bFound || pData->minx < *xOldest) *xOldest = pData->minx;
+        bFound = true;
+    }
+    return bFound;
+}
+
+
+// Moves the data layer iShift device pixels to the left
+void
+Plot2D::ScrollDataLayer(int iShift) {
+    int iWidth  = dataLayer.width();
+    int iHeight = dataLayer.height();
+    int iBytes  = 4; // Format_ARGB32_Premultiplied
+    for(int y=0; y<iHeight; y++) {
+        uchar* pLine = dataLayer.scanLine(y);
+        memmove(pLine, pLine+iBytes*iShift, size_t(iBytes*(iWidth-iShift)));
+        memset(pLine+iBytes*(iWidth-iShift), 0, size_t(iBytes*iShift));
+    }
+}
+
+
+static bool
+SameLimits(const AxisLimits& a, const AxisLimits& b) {
+    return (a.XMin == b.XMin) && (a.XMax == b.XMax) &&
+           (a.YMin == b.YMin) && (a.YMax == b.YMax) &&
+           (a.LogX == b.LogX) && (a.LogY == b.LogY);
+}
+
+
+// Background, frame, grid, tick labels and title only change with the
+// axis limits, the widget size and the plot properties: they are drawn
+// in a cached pixmap that is just blitted when only new data arrived.
+void
+Plot2D::DrawBackground(QPainter* painter, QFontMetrics fontMetrics) {
+    qreal dpr = PaintDpr();
+    if(bBackgroundDirty ||
+       (backgroundLayer.size() != PaintSize()*dpr) ||
+       (backgroundLayer.devicePixelRatio() != dpr) ||
+       !SameLimits(Ax, cachedAx))
+    {
+        backgroundLayer = QPixmap(PaintSize()*dpr);
+        backgroundLayer.setDevicePixelRatio(dpr);
+        backgroundLayer.fill(pPropertiesDlg->painterBkColor);
+        QPainter layerPainter(&backgroundLayer);
+        layerPainter.setFont(painter->font());
+        DrawFrame(&layerPainter, fontMetrics);
+        layerPainter.end();
+        // The tick routines may adjust the limits: compare with these
+        cachedAx    = Ax;
+        cachedXfact = xfact;
+        cachedYfact = yfact;
+        bBackgroundDirty = false;
+    }
+    else {
+        xfact = cachedXfact;
+        yfact = cachedYfact;
+    }
+    painter->drawPixmap(0, 0, backgroundLayer);
+}
+
+
 void
 Plot2D::LinePlot(QPainter* painter, DataStream2D* pData) {
     if(!pData->isShown) return;
@@ -674,55 +1071,111 @@ Plot2D::LinePlot(QPainter* painter, DataStream2D* pData) {
     QPen dataPen = QPen(pData->GetProperties().Color);
     dataPen.setWidth(pData->GetProperties().PenWidth);
     painter->setPen(dataPen);
-    int ix0, iy0, ix1, iy1;
-    double xlmin, ylmin;
-    if(Ax.XMin > 0.0)
-        xlmin = log10(Ax.XMin);
+
+    int iFirst, iLast;
+    if(!VisibleRange(pData, true, &iFirst, &iLast)) return;
+    // When many samples fall in the same pixel column draw the min/max
+    // decimated polyline instead: buckets are kept within a quarter of
+    // a pixel so that spikes are still drawn where they belong.
+    int iLevel = -1;
+    double xSpan = pData->m_pointArrayX[iLast] - pData->m_pointArrayX[iFirst];
+    if(pData->IsSortedX() && !Ax.LogX && (xSpan > 0.0)) {
+        double samplesPerPixel = (iLast-iFirst+1) / (xSpan*xfact);
+        iLevel = pData->GetLodLevel(0.25*samplesPerPixel);
+    }
+    if(iLevel < 0) {
+        TransformData(pData, iFirst, iLast);
+    }
+    else {
+        plotX.resize(0);
+        plotY.resize(0);
+        pData->GetLodPoints(iLevel, iFirst, iLast, plotX, plotY);
+        pixelPoints.resize(plotX.count());
+        TransformPoints(CurrentTransform(), plotX.constData(), plotY.constData(),
+                        plotX.count(), pixelPoints.data());
+    }
+    iMax = pixelPoints.count();
+
+    // The frame clips the whole polyline: each run of valid points is
+    // then submitted with a single drawPolyline(). Points that are not
+    // representable on a log axis break the line.
+    painter->save();
+    painter->setClipRect(QRectF(Pf.left, Pf.top, Pf.right-Pf.left, Pf.bottom-Pf.top));
+    const QPointF* pPoints = pixelPoints.constData();
+    int iStart = 0;
+    for(int i=0; i<=iMax; i++) {
+        if(i < iMax && !(qIsNaN(pPoints[i].x()) || qIsNaN(pPoints[i].y())))
+            continue;
+        if(i-iStart > 1)
+            painter->drawPolyline(pPoints+iStart, i-iStart);
+        iStart = i+1;
+    }
+    DrawLastPoint(painter, pData);
+    painter->restore();
+}
+
+
+// World to pixel mapping of the current frame
+PlotTransform
+Plot2D::CurrentTransform() {
+    PlotTransform t;
+    t.bLogX   = Ax.LogX;
+    t.bLogY   = Ax.LogY;
+    t.xScale  = xfact;
+    t.yScale  = yfact;
+    t.xOffset = Pf.left;
+    t.yOffset = Pf.bottom;
+    if(Ax.LogX)
+        t.xOrigin = Ax.XMin > 0.0 ? log10(Ax.XMin) : double(FLT_MIN);
     else
-        xlmin = double(FLT_MIN);
-    if(Ax.YMin > 0.0)
-        ylmin = log10(Ax.YMin);
-    else ylmin = double(FLT_MIN);
+        t.xOrigin = Ax.XMin;
+    if(Ax.LogY)
+        t.yOrigin = Ax.YMin > 0.0 ? log10(Ax.YMin) : double(FLT_MIN);
+    else
+        t.yOrigin = Ax.YMin;
+    return t;
+}
 
-    if(Ax.LogX) {
-        if(pData->m_pointArrayX[0] > 0.0)
-            ix0 = int((Pf.left + (log10(pData->m_pointArrayX[0]) - xlmin)*xfact));
-        else
-            ix0 =-INT_MAX; // Solo per escludere il punto
-    } else
-        ix0 = int((Pf.left + (pData->m_pointArrayX[0] - Ax.XMin)*xfact));
 
-    if(Ax.LogY) {
-        if(pData->m_pointArrayY[0] > 0.0)
-            iy0 = int((Pf.bottom + (log10(pData->m_pointArrayY[0]) - ylmin)*yfact));
-        else
-            iy0 =-INT_MAX; // Solo per escludere il punto
-    } else
-        iy0 = int((Pf.bottom + (pData->m_pointArrayY[0] - Ax.YMin)*yfact));
+// Pixel coordinates of the points [iFirst, iLast] into pixelPoints,
+// transformed straight from the (at most two) spans of the buffers.
+void
+Plot2D::TransformData(DataStream2D* pData, int iFirst, int iLast) {
+    int n = iLast-iFirst+1;
+    pixelPoints.resize(n);
+    PlotTransform t = CurrentTransform();
+    int nDone = 0;
+    while(nDone < n) {
+        int i = iFirst+nDone;
+        int nSpan = qMin(n-nDone, pData->m_pointArrayX.contiguousCount(i));
+        TransformPoints(t,
+                        pData->m_pointArrayX.dataAt(i),
+                        pData->m_pointArrayY.dataAt(i),
+                        nSpan,
+                        pixelPoints.data()+nDone);
+        nDone += nSpan;
+    }
+}
 
-    for(int i=1; i<iMax; i++) {
-        if(Ax.LogX)
-            ix1 = int(((log10(pData->m_pointArrayX[i]) - xlmin)*xfact) + Pf.left);
-        else
-            ix1 = int(((pData->m_pointArrayX[i] - Ax.XMin)*xfact) + Pf.left);
-        if(Ax.LogY)
-            if(pData->m_pointArrayY[i] > 0.0)
-                iy1 = int((Pf.bottom + (log10(pData->m_pointArrayY[i]) - ylmin)*yfact));
-            else
-                iy1 =-INT_MAX; // Solo per escludere il punto
-        else
-            iy1 = int((Pf.bottom + (pData->m_pointArrayY[i] - Ax.YMin)*yfact));
 
-        if(!(ix1<Pf.left || iy1<Pf.top || iy1>Pf.bottom)) {
-            painter->drawLine(ix0, iy0, ix1, iy1);
-        }
-        ix0 = ix1;
-        iy0 = iy1;
-        if(ix1 > Pf.right) {
-            break;
-        }
+// Range of the points to draw: with sorted x only the ones inside the
+// X axis limits (plus the two neighbours of the range when connecting
+// the points with lines). Returns false if there is nothing to draw.
+bool
+Plot2D::VisibleRange(DataStream2D* pData, bool bNeighbours, int* iFirst, int* iLast) {
+    int iMax = int(pData->m_pointArrayX.count());
+    *iFirst = 0;
+    *iLast  = iMax-1;
+    if(!pData->IsSortedX()) return iMax > 0;
+    *iFirst = pData->LowerBoundX(Ax.XMin);
+    *iLast  = pData->UpperBoundX(Ax.XMax)-1;
+    if(bNeighbours) {
+        if(*iFirst > 0) (*iFirst)--;
+        if(*iLast < iMax-1) (*iLast)++;
     }
-    DrawLastPoint(painter, pData);
+    // Strip chart: the older points are already drawn
+    if(*iFirst < iDrawFrom) *iFirst = iDrawFrom;
+    return *iFirst <= *iLast;
 }
 
 
@@ -771,39 +1224,26 @@ Plot2D::PointPlot(QPainter* painter, DataStream2D* pData) {
     QPen dataPen = QPen(pData->GetProperties().Color);
     dataPen.setWidth(pData->GetProperties().PenWidth);
     painter->setPen(dataPen);
-    int ix, iy;
-    double xlmin, ylmin;
-    if(Ax.XMin > 0.0)
-        xlmin = log10(Ax.XMin);
-    else
-        xlmin = double(FLT_MIN);
-    if(Ax.YMin > 0.0)
-        ylmin = log10(Ax.YMin);
-    else ylmin = double(FLT_MIN);
 
-    for (int i=0; i < iMax; i++) {
+    int iFirst, iLast;
+    if(!VisibleRange(pData, false, &iFirst, &iLast)) return;
+    TransformData(pData, iFirst, iLast);
+    // The points inside the limits are packed in front of the buffer
+    // and drawn with a single drawPoints()
+    QPointF* pPoints = pixelPoints.data();
+    int nPoints = 0;
+    for (int i=iFirst; i <= iLast; i++) {
         if(!(pData->m_pointArrayX[i] < Ax.XMin ||
              pData->m_pointArrayX[i] > Ax.XMax ||
              pData->m_pointArrayY[i] < Ax.YMin ||
              pData->m_pointArrayY[i] > Ax.YMax ))
         {
-            if(Ax.LogX) {
-                if(pData->m_pointArrayX[i] > 0.0)
-                    ix = int(((log10(pData->m_pointArrayX[i]) - xlmin)*xfact) + Pf.left);
-                else
-                    ix = -INT_MAX;
-            } else
-                ix = int(((pData->m_pointArrayX[i] - Ax.XMin)*xfact) + Pf.left);
-            if(Ax.LogY) {
-                if(pData->m_pointArrayY[i] > 0.0)
-                    iy = int((Pf.bottom + (log10(pData->m_pointArrayY[i]) - ylmin)*yfact));
-                else
-                    iy =-INT_MAX; // Solo per escludere il punto
-            } else
-                iy = int((Pf.bottom + (pData->m_pointArrayY[i] - Ax.YMin)*yfact));
-            painter->drawPoint(ix, iy);
+            const QPointF& point = pPoints[i-iFirst];
+            if(!(qIsNaN(point.x()) || qIsNaN(point.y())))
+                pPoints[nPoints++] = point;
         }
-    }//for (int i=0; i <= iMax; i++)
+    }//for (int i=iFirst; i <= iLast; i++)
+    painter->drawPoints(pPoints, nPoints);
 }
 
 
@@ -816,66 +1256,53 @@ Plot2D::ScatterPlot(QPainter* painter, DataStream2D* pData) {
     painter->setPen(dataPen);
     int ix, iy;
 
-    double xlmin, ylmin;
-    if(Ax.XMin > 0.0)
-        xlmin = log10(Ax.XMin);
-    else
-        xlmin = double(FLT_MIN);
-    if(Ax.YMin > 0.0)
-        ylmin = log10(Ax.YMin);
-    else ylmin = double(FLT_MIN);
-
     int SYMBOLS_DIM = 8;
     QSize Size(SYMBOLS_DIM, SYMBOLS_DIM);
 
-    for (int i=0; i < iMax; i++) {
+    int iFirst, iLast;
+    if(!VisibleRange(pData, false, &iFirst, &iLast)) return;
+    TransformData(pData, iFirst, iLast);
+    // All the symbols are collected and submitted with a single call
+    symbolLines.resize(0);
+    for (int i=iFirst; i <= iLast; i++) {
         if(pData->m_pointArrayX[i] >= Ax.XMin &&
            pData->m_pointArrayX[i] <= Ax.XMax &&
            pData->m_pointArrayY[i] >= Ax.YMin &&
            pData->m_pointArrayY[i] <= Ax.YMax)
         {
-            if(Ax.LogX)
-                if(pData->m_pointArrayX[i] > 0.0)
-                    ix = int(((log10(pData->m_pointArrayX[i]) - xlmin)*xfact) + Pf.left);
-                else
-                    ix = -INT_MAX;
-            else//Asse X Lineare
-                ix= int(((pData->m_pointArrayX[i] - Ax.XMin)*xfact) + Pf.left);
-            if(Ax.LogY) {
-                if(pData->m_pointArrayY[i] > 0.0)
-                    iy = int(((log10(pData->m_pointArrayY[i]) - ylmin)*yfact) + Pf.bottom);
-                else
-                    iy =-INT_MAX; // Solo per escludere il punto
-            } else
-                iy = int(((pData->m_pointArrayY[i] - Ax.YMin)*yfact) + Pf.bottom);
+            const QPointF& point = pixelPoints.at(i-iFirst);
+            if(qIsNaN(point.x()) || qIsNaN(point.y())) continue;
+            ix = int(point.x());
+            iy = int(point.y());
 
             if(pData->GetProperties().Symbol == iplus) {
-                painter->drawLine(ix, iy-Size.height()/2, ix, iy+Size.height()/2+1);
-                painter->drawLine(ix-Size.width()/2, iy, ix+Size.width()/2+1, iy);
+                symbolLines.append(QLine(ix, iy-Size.height()/2, ix, iy+Size.height()/2+1));
+                symbolLines.append(QLine(ix-Size.width()/2, iy, ix+Size.width()/2+1, iy));
             } else if(pData->GetProperties().Symbol == iper) {
-                painter->drawLine(ix-Size.width()/2+1, iy+Size.height()/2-1, ix+Size.width()/2-1, iy-Size.height()/2);
-                painter->drawLine(ix+Size.width()/2-1, iy+Size.height()/2-1, ix-Size.width()/2+1, iy-Size.height()/2);
+                symbolLines.append(QLine(ix-Size.width()/2+1, iy+Size.height()/2-1, ix+Size.width()/2-1, iy-Size.height()/2));
+                symbolLines.append(QLine(ix+Size.width()/2-1, iy+Size.height()/2-1, ix-Size.width()/2+1, iy-Size.height()/2));
             } else if(pData->GetProperties().Symbol == istar) {
-                painter->drawLine(ix, iy-Size.height()/2, ix, iy+Size.height()/2+1);
-                painter->drawLine(ix-Size.width()/2, iy, ix+Size.width()/2+1, iy);
-                painter->drawLine(ix-Size.width()/2+1, iy+Size.height()/2-1, ix+Size.width()/2-1, iy-Size.height()/2);
-                painter->drawLine(ix+Size.width()/2-1, iy+Size.height()/2-1, ix-Size.width()/2+1, iy-Size.height()/2);
+                symbolLines.append(QLine(ix, iy-Size.height()/2, ix, iy+Size.height()/2+1));
+                symbolLines.append(QLine(ix-Size.width()/2, iy, ix+Size.width()/2+1, iy));
+                symbolLines.append(QLine(ix-Size.width()/2+1, iy+Size.height()/2-1, ix+Size.width()/2-1, iy-Size.height()/2));
+                symbolLines.append(QLine(ix+Size.width()/2-1, iy+Size.height()/2-1, ix-Size.width()/2+1, iy-Size.height()/2));
             } else if(pData->GetProperties().Symbol == iuptriangle) {
-                painter->drawLine(ix, iy-Size.height()/2, ix+Size.width()/2, iy+Size.height()/2);
-                painter->drawLine(ix+Size.width()/2, iy+Size.height()/2, ix-Size.width()/2, iy+Size.height()/2);
-                painter->drawLine(ix-Size.width()/2, iy+Size.height()/2, ix, iy-Size.height()/2);
+                symbolLines.append(QLine(ix, iy-Size.height()/2, ix+Size.width()/2, iy+Size.height()/2));
+                symbolLines.append(QLine(ix+Size.width()/2, iy+Size.height()/2, ix-Size.width()/2, iy+Size.height()/2));
+                symbolLines.append(QLine(ix-Size.width()/2, iy+Size.height()/2, ix, iy-Size.height()/2));
             } else if(pData->GetProperties().Symbol == idntriangle) {
-                painter->drawLine(ix, iy+Size.height()/2, ix+Size.width()/2, iy-Size.height()/2);
-                painter->drawLine(ix+Size.width()/2, iy-Size.height()/2, ix-Size.width()/2, iy-Size.height()/2);
-                painter->drawLine(ix-Size.width()/2, iy-Size.height()/2, ix, iy+Size.height()/2);
+                symbolLines.append(QLine(ix, iy+Size.height()/2, ix+Size.width()/2, iy-Size.height()/2));
+                symbolLines.append(QLine(ix+Size.width()/2, iy-Size.height()/2, ix-Size.width()/2, iy-Size.height()/2));
+                symbolLines.append(QLine(ix-Size.width()/2, iy-Size.height()/2, ix, iy+Size.height()/2));
             } else if(pData->GetProperties().Symbol == icircle) {
                 painter->drawEllipse(QRect(ix-Size.width()/2, iy-Size.height()/2, Size.width(), Size.height()));
             } else {
-                painter->drawLine(ix-Size.width()/2, iy, ix-Size.width()/2, iy-Size.height());
-                painter->drawLine(ix, iy-Size.height()/2, ix-Size.width(), iy-Size.height()/2);
+                symbolLines.append(QLine(ix-Size.width()/2, iy, ix-Size.width()/2, iy-Size.height()));
+                symbolLines.append(QLine(ix, iy-Size.height()/2, ix-Size.width(), iy-Size.height()/2));
             }
         }
     }
+    painter->drawLines(symbolLines);
 }
 
 
@@ -932,6 +1359,7 @@ Plot2D::mouseReleaseEvent(QMouseEvent *event) {
                 y2 = y1;
                 y1 = tmp;
             }
+            if(bStripChart) stripSpan = x2-x1;
             SetLimits(x1, x2, y1, y2, Ax.AutoX, Ax.AutoY, Ax.LogX, Ax.LogY);
         }
         event->accept();
@@ -1009,6 +1437,14 @@ Plot2D::mouseDoubleClickEvent(QMouseEvent *event) {
 }
 
 
+void
+Plot2D::onConfigChanged() {
+    bBackgroundDirty = true;
+    bDataLayerDirty  = true;
+    UpdatePlot();
+}
+
+
 void
 Plot2D::UpdatePlot() {
     labelPen = pPropertiesDlg->labelColor;
@@ -1016,13 +1452,19 @@ Plot2D::UpdatePlot() {
     framePen = pPropertiesDlg->frameColor;
     gridPen.setWidth(pPropertiesDlg->gridPenWidth);
     update();
+    if(pGLLayer) pGLLayer->update();
 }
 
 
 void
 Plot2D::ClearPlot() {
+    dataSetIndex.clear();
+    stripDrawnSeq.clear();
+    bDataLayerDirty = true;
     while(!dataSetList.isEmpty()) {
-        delete dataSetList.takeFirst();
+        DataStream2D* pData = dataSetList.takeFirst();
+        if(pGLLayer) pGLLayer->forgetStream(pData);
+        delete pData;
     }
     update();
 }
@@ -22,11 +22,18 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "datastream2d.h"
 #include "AxisLimits.h"
 #include "AxisFrame.h"
+#include "plottransform.h"
 
 #include <QWidget>
 #include <QPen>
+#include <QPixmap>
+#include <QImage>
+#include <QHash>
+#include <QLine>
 
 
+QT_FORWARD_DECLARE_CLASS(PlotGLLayer)
+
 class Plot2D : public QWidget
 {
     Q_OBJECT
@@ -42,16 +49,26 @@ public:
     bool DelDataSet(int Id);
     bool ClearDataSet(int Id);
     void NewPoint(int Id, double x, double y);
+    void NewPoints(int Id, const double* x, const double* y, int n);
+    void NewPoints(const double* x, int n, const int* Ids, const double* const* y, int nColumns);
     void SetShowDataSet(int Id, bool Show);
     void SetShowTitle(int Id, bool show);
     void ClearPlot();
     void setMaxPoints(int nPoints);
     int  getMaxPoints();
+    void SetStripChart(bool bEnable, double xSpan);
+    bool IsStripChart();
+    void SetOpenGL(bool bEnable);
+    bool IsOpenGL();
+    QImage renderToImage(QSize imageSize, qreal dpr=1.0);
+    bool exportImage(QString sFileName, QSize imageSize, qreal dpr=1.0);
 
 signals:
+    void framePainted(); // For the latency measures
 
 public slots:
     void UpdatePlot();
+    void onConfigChanged();
 
 public:
     static const int iline       = 0;
@@ -67,26 +84,43 @@ protected:
     void closeEvent(QCloseEvent *event);
     void keyPressEvent(QKeyEvent *e);
     void paintEvent(QPaintEvent *event);
+    void resizeEvent(QResizeEvent *event);
+    void PaintPlot(QPainter* painter);
+    QSize PaintSize() const;
+    qreal PaintDpr() const;
     void DrawPlot(QPainter* painter, QFontMetrics fontMetrics);
     void DrawFrame(QPainter* painter, QFontMetrics fontMetrics);
+    void DrawBackground(QPainter* painter, QFontMetrics fontMetrics);
     void XTicLin(QPainter* painter, QFontMetrics fontMetrics);
     void XTicLog(QPainter* painter, QFontMetrics fontMetrics);
     void YTicLin(QPainter* painter, QFontMetrics fontMetrics);
     void YTicLog(QPainter* painter, QFontMetrics fontMetrics);
     void DrawData(QPainter* painter, QFontMetrics fontMetrics);
+    void DrawStripData(QPainter* painter, QFontMetrics fontMetrics);
+    void DrawGLData(QPainter* painter, QFontMetrics fontMetrics);
+    void ScrollDataLayer(int iShift);
+    bool NewestX(double* xNewest);
+    bool OldestX(double* xOldest);
     void LinePlot(QPainter* painter, DataStream2D *pData);
     void PointPlot(QPainter* painter, DataStream2D* pData);
     void ScatterPlot(QPainter* painter, DataStream2D* pData);
     void DrawLastPoint(QPainter* painter, DataStream2D* pData);
+    bool VisibleRange(DataStream2D* pData, bool bNeighbours, int* iFirst, int* iLast);
+    PlotTransform CurrentTransform();
+    void TransformData(DataStream2D* pData, int iFirst, int iLast);
     void ShowTitle(QPainter* painter, QFontMetrics fontMetrics, DataStream2D* pData);
     void mousePressEvent(QMouseEvent *event);
     void mouseReleaseEvent(QMouseEvent *event);
     void mouseMoveEvent(QMouseEvent *event);
     void mouseDoubleClickEvent(QMouseEvent *event);
 //  void wheelEvent(QWheelEvent* event);
+    DataStream2D* FindDataSet(int Id);
+
+    friend class PlotGLLayer; // Paints through PaintPlot()
 
 protected:
     QList<DataStream2D*> dataSetList;
+    QHash<int, DataStream2D*> dataSetIndex; // Id -> Data Set
     QPen labelPen;
     QPen gridPen;
     QPen framePen;
@@ -101,4 +135,27 @@ protected:
     double xfact, yfact;
     QPoint lastPos, zoomStart, zoomEnd;
     plotPropertiesDlg* pPropertiesDlg;
+    QVector<double> plotX, plotY; // Reused by LinePlot()
+    QVector<QPointF> pixelPoints; // Reused by the plot routines
+    QVector<QLine> symbolLines;   // Reused by ScatterPlot()
+    // Cached static layer (see DrawBackground())
+    QPixmap backgroundLayer;
+    bool bBackgroundDirty;
+    AxisLimits cachedAx;
+    double cachedXfact, cachedYfact;
+    // Strip chart mode (see DrawStripData())
+    bool bStripChart;
+    double stripSpan;
+    bool bStripAutoX, bStripLogX; // X axis settings to restore
+    QImage dataLayer;
+    bool bDataLayerDirty;
+    AxisLimits stripAx;
+    double stripXMin;             // x at the left edge of dataLayer
+    double stripXfact, stripYfact;
+    QHash<DataStream2D*, quint64> stripDrawnSeq;
+    int iDrawFrom;                // First point to draw (VisibleRange())
+    QVector<double> bulkX, bulkY; // Reused by NewPoints()
+    PlotGLLayer* pGLLayer;        // OpenGL backend (see SetOpenGL())
+    QSize renderSize;             // Valid while in renderToImage()
+    qreal renderDpr;
 };
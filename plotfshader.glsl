@@ -0,0 +1,12 @@
+#ifdef GL_ES
+// Set default precision to medium
+precision mediump int;
+precision mediump float;
+#endif
+
+uniform vec4 u_color;
+
+void main()
+{
+    gl_FragColor = u_color;
+}
@@ -0,0 +1,284 @@
+/*
+ *
+Copyright (C) 2016  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include "plotgllayer.h"
+#include "plot2d.h"
+#include "datastream2d.h"
+
+#include <QPainter>
+#include <QOpenGLContext>
+#include <QtNumeric>
+#include <math.h>
+
+
+#ifndef GL_VERTEX_PROGRAM_POINT_SIZE
+#define GL_VERTEX_PROGRAM_POINT_SIZE 0x8642
+#endif
+
+
+PlotGLLayer::PlotGLLayer(Plot2D *parent)
+    : QOpenGLWidget(parent)
+    , pPlot(parent)
+    , bReady(false)
+    , iPosition(-1)
+{
+    // The plot keeps handling the mouse and the keyboard
+    setAttribute(Qt::WA_TransparentForMouseEvents);
+    setFocusPolicy(Qt::NoFocus);
+}
+
+
+PlotGLLayer::~PlotGLLayer() {
+    makeCurrent();
+    QHashIterator<DataStream2D*, StreamBuffer*> it(buffers);
+    while(it.hasNext()) {
+        it.next();
+        it.value()->vbo.destroy();
+        delete it.value();
+    }
+    buffers.clear();
+    doneCurrent();
+}
+
+
+void
+PlotGLLayer::initializeGL() {
+    initializeOpenGLFunctions();
+    bReady = program.addShaderFromSourceFile(QOpenGLShader::Vertex, ":/plotvshader.glsl") &&
+             program.addShaderFromSourceFile(QOpenGLShader::Fragment, ":/plotfshader.glsl") &&
+             program.link();
+    if(bReady)
+        iPosition = program.attributeLocation("a_position");
+}
+
+
+void
+PlotGLLayer::paintGL() {
+    QPainter painter(this);
+    pPlot->PaintPlot(&painter);
+    painter.end();
+    emit pPlot->framePainted();
+}
+
+
+// Without the shaders the plot falls back to QPainter drawing
+bool
+PlotGLLayer::isReady() const {
+    return bReady;
+}
+
+
+// To be called between QPainter::beginNativePainting() and
+// endNativePainting(): the points are clipped to the plot frame
+void
+PlotGLLayer::beginData(const QRectF& frame) {
+    qreal dpr = devicePixelRatioF();
+    glViewport(0, 0, int(width()*dpr), int(height()*dpr));
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_CULL_FACE);
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(int(frame.left()*dpr), int((height()-frame.bottom())*dpr),
+              int(frame.width()*dpr)+1, int(frame.height()*dpr)+1);
+    if(!context()->isOpenGLES())
+        glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
+    program.bind();
+    program.enableAttributeArray(iPosition);
+}
+
+
+void
+PlotGLLayer::endData() {
+    program.disableAttributeArray(iPosition);
+    program.release();
+    QOpenGLBuffer::release(QOpenGLBuffer::VertexBuffer);
+    glDisable(GL_SCISSOR_TEST);
+    if(!context()->isOpenGLES())
+        glDisable(GL_VERTEX_PROGRAM_POINT_SIZE);
+}
+
+
+// A deleted Data Set gives back its buffer
+void
+PlotGLLayer::forgetStream(DataStream2D* pData) {
+    StreamBuffer* pBuffer = buffers.take(pData);
+    if(!pBuffer) return;
+    makeCurrent();
+    pBuffer->vbo.destroy();
+    doneCurrent();
+    delete pBuffer;
+}
+
+
+void
+PlotGLLayer::reset(StreamBuffer* pBuffer, int capacity, bool bLogX, bool bLogY, quint64 fromSeq) {
+    pBuffer->vbo.bind();
+    pBuffer->vbo.allocate((capacity+1)*2*int(sizeof(float)));
+    pBuffer->capacity    = capacity;
+    pBuffer->uploadedSeq = fromSeq;
+    pBuffer->bLogX       = bLogX;
+    pBuffer->bLogY       = bLogY;
+    pBuffer->bBaseSet    = false;
+    pBuffer->xBase       = 0.0;
+    pBuffer->yBase       = 0.0;
+    pBuffer->invalidSeq.clear();
+}
+
+
+// Writes n points from slot iSlot on (no wrap), keeping the mirror slot
+void
+PlotGLLayer::write(StreamBuffer* pBuffer, int iSlot, const float* pXY, int n) {
+    const int pointSize = 2*int(sizeof(float));
+    pBuffer->vbo.write(iSlot*pointSize, pXY, n*pointSize);
+    if(iSlot == 0)
+        pBuffer->vbo.write(pBuffer->capacity*pointSize, pXY, pointSize);
+}
+
+
+// Uploads the points appended since the previous call. The values are
+// stored relative to a base (log10 of them on logarithmic axes) to keep
+// the float precision; the base follows the data once the window has
+// moved farther from it than its own width, i.e. a full upload every
+// window of points at most.
+void
+PlotGLLayer::upload(DataStream2D* pData, StreamBuffer* pBuffer, bool bLogX, bool bLogY) {
+    int capacity = pData->m_pointArrayX.capacity();
+    int nPoints  = pData->m_pointArrayX.count();
+    quint64 nTotal    = pData->GetTotalPoints();
+    quint64 oldestSeq = nTotal-quint64(nPoints);
+    bool bReset = (capacity != pBuffer->capacity) ||
+                  (bLogX != pBuffer->bLogX) ||
+                  (bLogY != pBuffer->bLogY) ||
+                  (nTotal < pBuffer->uploadedSeq);
+    if(!bReset && pBuffer->bBaseSet && !bLogX && nPoints > 1) {
+        double xOldest = pData->m_pointArrayX.first();
+        double xDrift = fabs(xOldest-pBuffer->xBase);
+        bReset = xDrift > fabs(pData->m_pointArrayX.last()-xOldest);
+    }
+    if(bReset) reset(pBuffer, capacity, bLogX, bLogY, oldestSeq);
+    else pBuffer->vbo.bind();
+    if(capacity == 0) return;
+
+    quint64 fromSeq = qMax(pBuffer->uploadedSeq, oldestSeq);
+    int n = int(nTotal-fromSeq);
+    pBuffer->uploadedSeq = nTotal;
+    if(n <= 0) return;
+    int iFirst = nPoints-n;
+    if(!pBuffer->bBaseSet) {
+        pBuffer->xBase = bLogX ? 0.0 : pData->m_pointArrayX.at(iFirst);
+        pBuffer->yBase = bLogY ? 0.0 : pData->m_pointArrayY.at(iFirst);
+        pBuffer->bBaseSet = true;
+    }
+    stageX.resize(n);
+    stageY.resize(n);
+    stageXY.resize(2*n);
+    pData->m_pointArrayX.copyTo(iFirst, n, stageX.data());
+    pData->m_pointArrayY.copyTo(iFirst, n, stageY.data());
+    float* pXY = stageXY.data();
+    for(int i=0; i<n; i++) {
+        double x = stageX.at(i);
+        double y = stageY.at(i);
+        if(bLogX) x = x > 0.0 ? log10(x) : qQNaN();
+        if(bLogY) y = y > 0.0 ? log10(y) : qQNaN();
+        // Kept out of the draw ranges: any finite value will do
+        if(qIsNaN(x) || qIsNaN(y)) {
+            pBuffer->invalidSeq.append(fromSeq+quint64(i));
+            x = pBuffer->xBase;
+            y = pBuffer->yBase;
+        }
+        pXY[2*i]   = float(x-pBuffer->xBase);
+        pXY[2*i+1] = float(y-pBuffer->yBase);
+    }
+    int iSlot = int(fromSeq % quint64(capacity));
+    int nFirst = qMin(n, capacity-iSlot);
+    write(pBuffer, iSlot, pXY, nFirst);
+    if(n > nFirst)
+        write(pBuffer, 0, pXY+2*nFirst, n-nFirst);
+}
+
+
+void
+PlotGLLayer::drawStream(DataStream2D* pData, const PlotTransform& t) {
+    StreamBuffer* pBuffer = buffers.value(pData);
+    if(!pBuffer) {
+        pBuffer = new StreamBuffer;
+        pBuffer->vbo = QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
+        pBuffer->vbo.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+        pBuffer->vbo.create();
+        pBuffer->capacity    = -1;
+        pBuffer->uploadedSeq = 0;
+        pBuffer->bLogX = pBuffer->bLogY = false;
+        buffers.insert(pData, pBuffer);
+    }
+    upload(pData, pBuffer, t.bLogX, t.bLogY);
+    int nPoints = pData->m_pointArrayX.count();
+    if(nPoints == 0) return;
+
+    // pixel = (value-origin)*scale + offset, then pixel to clip space
+    double w = width()  > 0 ? width()  : 1;
+    double h = height() > 0 ? height() : 1;
+    double xOffset = (pBuffer->xBase-t.xOrigin)*t.xScale + t.xOffset;
+    double yOffset = (pBuffer->yBase-t.yOrigin)*t.yScale + t.yOffset;
+    program.setUniformValue("u_scale", float(2.0*t.xScale/w), float(-2.0*t.yScale/h));
+    program.setUniformValue("u_offset", float(2.0*xOffset/w-1.0), float(1.0-2.0*yOffset/h));
+    program.setAttributeBuffer(iPosition, GL_FLOAT, 0, 2);
+
+    DataSetProperties properties = pData->GetProperties();
+    program.setUniformValue("u_color", properties.Color);
+    GLenum mode = GL_POINTS;
+    float pointSize = float(qMax(1, properties.PenWidth));
+    if(properties.Symbol == Plot2D::iline) {
+        mode = GL_LINE_STRIP;
+        glLineWidth(pointSize);
+    }
+    else if(properties.Symbol != Plot2D::ipoint) {
+        pointSize = 3.0f*pointSize+2.0f; // The symbols become square markers
+    }
+    program.setUniformValue("u_pointSize", pointSize);
+
+    // The runs between the points that cannot be mapped
+    quint64 oldestSeq = pData->GetTotalPoints()-quint64(nPoints);
+    QVector<quint64>& invalidSeq = pBuffer->invalidSeq;
+    int nGone = 0;
+    while(nGone < invalidSeq.count() && invalidSeq.at(nGone) < oldestSeq)
+        nGone++;
+    if(nGone > 0) invalidSeq.remove(0, nGone);
+    quint64 runStart = oldestSeq;
+    for(int i=0; i<invalidSeq.count(); i++) {
+        drawRange(pBuffer, mode, runStart, int(invalidSeq.at(i)-runStart));
+        runStart = invalidSeq.at(i)+1;
+    }
+    drawRange(pBuffer, mode, runStart, int(oldestSeq+quint64(nPoints)-runStart));
+}
+
+
+// Draws n points from sequence fromSeq on, across the end of the ring
+void
+PlotGLLayer::drawRange(const StreamBuffer* pBuffer, GLenum mode, quint64 fromSeq, int n) {
+    if(n <= 0) return;
+    int capacity = pBuffer->capacity;
+    int iSlot = int(fromSeq % quint64(capacity));
+    if(iSlot+n <= capacity) {
+        glDrawArrays(mode, iSlot, n);
+    }
+    else {
+        int nFirst = capacity-iSlot;
+        // The line strip goes on to the mirror of slot 0
+        glDrawArrays(mode, iSlot, mode == GL_LINE_STRIP ? nFirst+1 : nFirst);
+        glDrawArrays(mode, 0, n-nFirst);
+    }
+}
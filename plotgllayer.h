@@ -0,0 +1,86 @@
+/*
+ *
+Copyright (C) 2016  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QOpenGLWidget>
+#include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLBuffer>
+#include <QHash>
+#include <QVector>
+#include <QRectF>
+
+#include "plottransform.h"
+
+
+QT_FORWARD_DECLARE_CLASS(Plot2D)
+QT_FORWARD_DECLARE_CLASS(DataStream2D)
+
+
+// OpenGL backend of Plot2D: a child covering the whole plot that paints
+// the frame and the labels with the usual QPainter code (see
+// Plot2D::PaintPlot()) and the Data Sets from vertex buffers.
+// Every Data Set owns a VBO laid out like a ring: the point of sequence
+// s lives in slot s % capacity, so only the points appended since the
+// previous frame are uploaded. Slot capacity mirrors slot 0, letting a
+// wrapped line strip be drawn with two glDrawArrays() calls. Points
+// that cannot be mapped (not positive on a log axis) are skipped by
+// splitting the draw range, breaking the line as LinePlot() does.
+// Only OpenGL 2.0 / ES 2.0 features are used (i.e. Mesa llvmpipe works).
+class PlotGLLayer : public QOpenGLWidget, protected QOpenGLFunctions
+{
+    Q_OBJECT
+
+public:
+    explicit PlotGLLayer(Plot2D *parent);
+    ~PlotGLLayer();
+
+    bool isReady() const;
+    void beginData(const QRectF& frame);
+    void drawStream(DataStream2D* pData, const PlotTransform& t);
+    void endData();
+    void forgetStream(DataStream2D* pData);
+
+protected:
+    void initializeGL() override;
+    void paintGL() override;
+
+    struct StreamBuffer {
+        QOpenGLBuffer vbo;
+        int     capacity;    // Slots, plus the mirror of slot 0
+        quint64 uploadedSeq; // Sequence of the next point to upload
+        bool    bLogX, bLogY;
+        bool    bBaseSet;
+        double  xBase, yBase; // Subtracted before the float conversion
+        QVector<quint64> invalidSeq; // Points never drawn, in order
+    };
+    void upload(DataStream2D* pData, StreamBuffer* pBuffer, bool bLogX, bool bLogY);
+    void reset(StreamBuffer* pBuffer, int capacity, bool bLogX, bool bLogY, quint64 fromSeq);
+    void write(StreamBuffer* pBuffer, int iSlot, const float* pXY, int n);
+    void drawRange(const StreamBuffer* pBuffer, GLenum mode, quint64 fromSeq, int n);
+
+protected:
+    Plot2D* pPlot;
+    QOpenGLShaderProgram program;
+    bool bReady;
+    int  iPosition;
+    QHash<DataStream2D*, StreamBuffer*> buffers;
+    QVector<double> stageX, stageY; // Reused by upload()
+    QVector<float>  stageXY;
+};
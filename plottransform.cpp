@@ -0,0 +1,249 @@
+/*
+ *
+Copyright (C) 2016  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include "plottransform.h"
+
+#include <math.h>
+#include <QtNumeric>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define PLOT_TRANSFORM_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(PLOT_TRANSFORM_SSE2) && \
+    (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define PLOT_TRANSFORM_AVX2
+#include <immintrin.h>
+#endif
+
+
+// log10(v) = (e*ln(2) + ln(m)) / ln(10) with v = m*2^e, sqrt(0.5) <= m < sqrt(2)
+// and ln(m) = 2*atanh(s) = 2*s*(1 + s^2/3 + s^4/5 + ...), s = (m-1)/(m+1).
+// With |s| < 0.172 six terms give a relative error below 1e-10.
+static const double dLn2      = 0.69314718055994530942;
+static const double dInvLn10  = 0.43429448190325182765;
+static const double dSqrt2    = 1.41421356237309504880;
+static const double dTwoTo52  = 4503599627370496.0;
+
+
+PlotTransform::PlotTransform()
+    : xOrigin(0.0)
+    , xScale(1.0)
+    , xOffset(0.0)
+    , yOrigin(0.0)
+    , yScale(1.0)
+    , yOffset(0.0)
+    , bLogX(false)
+    , bLogY(false)
+{
+}
+
+
+static void
+transformScalar(const PlotTransform& t,
+                const double* x, const double* y, int n,
+                QPointF* out)
+{
+    for(int i=0; i<n; i++) {
+        double wx = x[i];
+        double wy = y[i];
+        if(t.bLogX) wx = wx > 0.0 ? log10(wx) : qQNaN();
+        if(t.bLogY) wy = wy > 0.0 ? log10(wy) : qQNaN();
+        out[i].setX((wx-t.xOrigin)*t.xScale + t.xOffset);
+        out[i].setY((wy-t.yOrigin)*t.yScale + t.yOffset);
+    }
+}
+
+
+#if defined(PLOT_TRANSFORM_SSE2)
+static inline __m128d
+log10Sse2(__m128d v) {
+    const __m128i mantissaMask = _mm_set1_epi64x(0x000FFFFFFFFFFFFFLL);
+    const __m128i exponentOne  = _mm_set1_epi64x(0x3FF0000000000000LL);
+    const __m128i twoTo52      = _mm_set1_epi64x(0x4330000000000000LL);
+    const __m128d one          = _mm_set1_pd(1.0);
+    __m128i bits = _mm_castpd_si128(v);
+    // Biased exponent converted to double through the 2^52 trick
+    __m128d e = _mm_castsi128_pd(_mm_or_si128(_mm_srli_epi64(bits, 52), twoTo52));
+    e = _mm_sub_pd(e, _mm_set1_pd(dTwoTo52+1023.0));
+    __m128d m = _mm_castsi128_pd(_mm_or_si128(_mm_and_si128(bits, mantissaMask), exponentOne));
+    __m128d big = _mm_cmpgt_pd(m, _mm_set1_pd(dSqrt2));
+    m = _mm_sub_pd(m, _mm_and_pd(big, _mm_mul_pd(m, _mm_set1_pd(0.5))));
+    e = _mm_add_pd(e, _mm_and_pd(big, one));
+    __m128d s  = _mm_div_pd(_mm_sub_pd(m, one), _mm_add_pd(m, one));
+    __m128d s2 = _mm_mul_pd(s, s);
+    __m128d p  = _mm_set1_pd(1.0/11.0);
+    p = _mm_add_pd(_mm_mul_pd(p, s2), _mm_set1_pd(1.0/9.0));
+    p = _mm_add_pd(_mm_mul_pd(p, s2), _mm_set1_pd(1.0/7.0));
+    p = _mm_add_pd(_mm_mul_pd(p, s2), _mm_set1_pd(1.0/5.0));
+    p = _mm_add_pd(_mm_mul_pd(p, s2), _mm_set1_pd(1.0/3.0));
+    p = _mm_add_pd(_mm_mul_pd(p, s2), one);
+    __m128d lnm = _mm_mul_pd(_mm_add_pd(s, s), p);
+    __m128d r = _mm_mul_pd(_mm_add_pd(_mm_mul_pd(e, _mm_set1_pd(dLn2)), lnm),
+                           _mm_set1_pd(dInvLn10));
+    // Not positive values (and NaNs) cannot be mapped
+    __m128d valid = _mm_cmpgt_pd(v, _mm_setzero_pd());
+    return _mm_or_pd(_mm_and_pd(valid, r),
+                     _mm_andnot_pd(valid, _mm_set1_pd(qQNaN())));
+}
+
+
+static void
+transformSse2(const PlotTransform& t,
+              const double* x, const double* y, int n,
+              QPointF* out)
+{
+    double* pOut = reinterpret_cast<double*>(out);
+    const __m128d xOrigin = _mm_set1_pd(t.xOrigin);
+    const __m128d xScale  = _mm_set1_pd(t.xScale);
+    const __m128d xOffset = _mm_set1_pd(t.xOffset);
+    const __m128d yOrigin = _mm_set1_pd(t.yOrigin);
+    const __m128d yScale  = _mm_set1_pd(t.yScale);
+    const __m128d yOffset = _mm_set1_pd(t.yOffset);
+    int i = 0;
+    for(; i+2<=n; i+=2) {
+        __m128d vx = _mm_loadu_pd(x+i);
+        __m128d vy = _mm_loadu_pd(y+i);
+        if(t.bLogX) vx = log10Sse2(vx);
+        if(t.bLogY) vy = log10Sse2(vy);
+        vx = _mm_add_pd(_mm_mul_pd(_mm_sub_pd(vx, xOrigin), xScale), xOffset);
+        vy = _mm_add_pd(_mm_mul_pd(_mm_sub_pd(vy, yOrigin), yScale), yOffset);
+        _mm_storeu_pd(pOut+2*i,   _mm_unpacklo_pd(vx, vy));
+        _mm_storeu_pd(pOut+2*i+2, _mm_unpackhi_pd(vx, vy));
+    }
+    transformScalar(t, x+i, y+i, n-i, out+i);
+}
+#endif // PLOT_TRANSFORM_SSE2
+
+
+#if defined(PLOT_TRANSFORM_AVX2)
+__attribute__((target("avx2")))
+static inline __m256d
+log10Avx2(__m256d v) {
+    const __m256i mantissaMask = _mm256_set1_epi64x(0x000FFFFFFFFFFFFFLL);
+    const __m256i exponentOne  = _mm256_set1_epi64x(0x3FF0000000000000LL);
+    const __m256i twoTo52      = _mm256_set1_epi64x(0x4330000000000000LL);
+    const __m256d one          = _mm256_set1_pd(1.0);
+    __m256i bits = _mm256_castpd_si256(v);
+    __m256d e = _mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(bits, 52), twoTo52));
+    e = _mm256_sub_pd(e, _mm256_set1_pd(dTwoTo52+1023.0));
+    __m256d m = _mm256_castsi256_pd(_mm256_or_si256(_mm256_and_si256(bits, mantissaMask), exponentOne));
+    __m256d big = _mm256_cmp_pd(m, _mm256_set1_pd(dSqrt2), _CMP_GT_OQ);
+    m = _mm256_blendv_pd(m, _mm256_mul_pd(m, _mm256_set1_pd(0.5)), big);
+    e = _mm256_add_pd(e, _mm256_and_pd(big, one));
+    __m256d s  = _mm256_div_pd(_mm256_sub_pd(m, one), _mm256_add_pd(m, one));
+    __m256d s2 = _mm256_mul_pd(s, s);
+    __m256d p  = _mm256_set1_pd(1.0/11.0);
+    p = _mm256_add_pd(_mm256_mul_pd(p, s2), _mm256_set1_pd(1.0/9.0));
+    p = _mm256_add_pd(_mm256_mul_pd(p, s2), _mm256_set1_pd(1.0/7.0));
+    p = _mm256_add_pd(_mm256_mul_pd(p, s2), _mm256_set1_pd(1.0/5.0));
+    p = _mm256_add_pd(_mm256_mul_pd(p, s2), _mm256_set1_pd(1.0/3.0));
+    p = _mm256_add_pd(_mm256_mul_pd(p, s2), one);
+    __m256d lnm = _mm256_mul_pd(_mm256_add_pd(s, s), p);
+    __m256d r = _mm256_mul_pd(_mm256_add_pd(_mm256_mul_pd(e, _mm256_set1_pd(dLn2)), lnm),
+                              _mm256_set1_pd(dInvLn10));
+    __m256d valid = _mm256_cmp_pd(v, _mm256_setzero_pd(), _CMP_GT_OQ);
+    return _mm256_blendv_pd(_mm256_set1_pd(qQNaN()), r, valid);
+}
+
+
+__attribute__((target("avx2")))
+static void
+transformAvx2(const PlotTransform& t,
+              const double* x, const double* y, int n,
+              QPointF* out)
+{
+    double* pOut = reinterpret_cast<double*>(out);
+    const __m256d xOrigin = _mm256_set1_pd(t.xOrigin);
+    const __m256d xScale  = _mm256_set1_pd(t.xScale);
+    const __m256d xOffset = _mm256_set1_pd(t.xOffset);
+    const __m256d yOrigin = _mm256_set1_pd(t.yOrigin);
+    const __m256d yScale  = _mm256_set1_pd(t.yScale);
+    const __m256d yOffset = _mm256_set1_pd(t.yOffset);
+    int i = 0;
+    for(; i+4<=n; i+=4) {
+        __m256d vx = _mm256_loadu_pd(x+i);
+        __m256d vy = _mm256_loadu_pd(y+i);
+        if(t.bLogX) vx = log10Avx2(vx);
+        if(t.bLogY) vy = log10Avx2(vy);
+        vx = _mm256_add_pd(_mm256_mul_pd(_mm256_sub_pd(vx, xOrigin), xScale), xOffset);
+        vy = _mm256_add_pd(_mm256_mul_pd(_mm256_sub_pd(vy, yOrigin), yScale), yOffset);
+        // (x0 y0 x2 y2) and (x1 y1 x3 y3) -> (x0 y0 x1 y1) and (x2 y2 x3 y3)
+        __m256d lo = _mm256_unpacklo_pd(vx, vy);
+        __m256d hi = _mm256_unpackhi_pd(vx, vy);
+        _mm256_storeu_pd(pOut+2*i,   _mm256_permute2f128_pd(lo, hi, 0x20));
+        _mm256_storeu_pd(pOut+2*i+4, _mm256_permute2f128_pd(lo, hi, 0x31));
+    }
+    transformSse2(t, x+i, y+i, n-i, out+i);
+}
+#endif // PLOT_TRANSFORM_AVX2
+
+
+bool
+TransformKernelAvailable(TransformKernel kernel) {
+    // The vector paths store QPointF as two packed doubles
+    const bool bPacked = sizeof(QPointF) == 2*sizeof(double);
+    switch(kernel) {
+    case kernelAuto:
+    case kernelScalar:
+        return true;
+#if defined(PLOT_TRANSFORM_SSE2)
+    case kernelSse2:
+        return bPacked;
+#endif
+#if defined(PLOT_TRANSFORM_AVX2)
+    case kernelAvx2: {
+        static const bool bHasAvx2 = __builtin_cpu_supports("avx2");
+        return bPacked && bHasAvx2;
+    }
+#endif
+    default:
+        return false;
+    }
+}
+
+
+void
+TransformPoints(const PlotTransform& t,
+                const double* x, const double* y, int n,
+                QPointF* out, TransformKernel kernel)
+{
+    if(n <= 0) return;
+    if(kernel == kernelAuto || !TransformKernelAvailable(kernel)) {
+        static const TransformKernel fastest =
+            TransformKernelAvailable(kernelAvx2) ? kernelAvx2 :
+            TransformKernelAvailable(kernelSse2) ? kernelSse2 : kernelScalar;
+        kernel = fastest;
+    }
+    switch(kernel) {
+#if defined(PLOT_TRANSFORM_AVX2)
+    case kernelAvx2:
+        transformAvx2(t, x, y, n, out);
+        return;
+#endif
+#if defined(PLOT_TRANSFORM_SSE2)
+    case kernelSse2:
+        transformSse2(t, x, y, n, out);
+        return;
+#endif
+    default:
+        transformScalar(t, x, y, n, out);
+    }
+}
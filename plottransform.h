@@ -0,0 +1,55 @@
+/*
+ *
+Copyright (C) 2016  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QPointF>
+
+
+// World to pixel mapping of a plot frame:
+//   pixel = (world - origin) * scale + offset
+// where world is log10(value) on logarithmic axes. Values that cannot
+// be mapped (not positive on a logarithmic axis) become NaN.
+class PlotTransform
+{
+public:
+    PlotTransform();
+
+    double xOrigin, xScale, xOffset;
+    double yOrigin, yScale, yOffset;
+    bool   bLogX, bLogY;
+};
+
+
+// Implementations of TransformPoints(): kernelAuto is the fastest one
+// available, the others are forced for the benchmarks
+enum TransformKernel {
+    kernelAuto,
+    kernelScalar,
+    kernelSse2,
+    kernelAvx2
+};
+
+
+// Converts n samples to pixel coordinates, using SSE2 or AVX2 when
+// available (the choice is made once at run time). A kernel not
+// available on this machine falls back to kernelAuto.
+void TransformPoints(const PlotTransform& t,
+                     const double* x, const double* y, int n,
+                     QPointF* out, TransformKernel kernel=kernelAuto);
+bool TransformKernelAvailable(TransformKernel kernel);
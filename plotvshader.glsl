@@ -0,0 +1,17 @@
+#ifdef GL_ES
+// The positions need more than medium precision
+precision highp float;
+#endif
+
+// Data (relative to the stream base) to clip space: the axis transform
+uniform vec2 u_scale;
+uniform vec2 u_offset;
+uniform float u_pointSize;
+
+attribute vec2 a_position;
+
+void main()
+{
+    gl_Position  = vec4(a_position*u_scale + u_offset, 0.0, 1.0);
+    gl_PointSize = u_pointSize;
+}
@@ -0,0 +1,163 @@
+/*
+ *
+Copyright (C) 2016  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include "repaintscheduler.h"
+
+#include <QGuiApplication>
+#include <QScreen>
+
+
+RepaintScheduler::RepaintScheduler(QObject *parent)
+    : QObject(parent)
+    , frameInterval(16666667)
+    , lastFrame(-1)
+    , dirtySince(-1)
+    , requestedFps(0.0)
+    , nFrames(0)
+    , nSkipped(0)
+    , nCoalesced(0)
+    , fpsWindowStart(0)
+    , nFpsWindowFrames(0)
+    , currentFps(0.0)
+{
+    frameTimer.setSingleShot(true);
+    frameTimer.setTimerType(Qt::PreciseTimer);
+    connect(&frameTimer, SIGNAL(timeout()),
+            this, SLOT(onFrame()));
+    clock.start();
+    setMaxFps(0.0);
+}
+
+
+int
+RepaintScheduler::addTarget(QObject* pTarget, const char* pMethod) {
+    Target target;
+    target.pObject = pTarget;
+    target.method  = pMethod;
+    target.bDirty  = false;
+    targets.append(target);
+    return targets.count()-1;
+}
+
+
+// fps <= 0: the refresh rate of the primary screen
+void
+RepaintScheduler::setMaxFps(double fps) {
+    requestedFps = fps > 0.0 ? fps : 0.0;
+    double rate = requestedFps;
+    if(rate <= 0.0) {
+        QScreen* pScreen = QGuiApplication::primaryScreen();
+        rate = (pScreen && pScreen->refreshRate() > 1.0) ? pScreen->refreshRate() : 60.0;
+    }
+    frameInterval = qint64(1.0e9/rate);
+}
+
+
+double
+RepaintScheduler::maxFps() const {
+    return requestedFps;
+}
+
+
+void
+RepaintScheduler::markDirty(int iTarget) {
+    if(iTarget < 0 || iTarget >= targets.count()) return;
+    Target& target = targets[iTarget];
+    if(target.bDirty) {
+        nCoalesced++;
+        return;
+    }
+    target.bDirty = true;
+    qint64 now = clock.nsecsElapsed();
+    if(dirtySince < 0) dirtySince = now;
+    if(frameTimer.isActive()) return;
+    qint64 wait = lastFrame < 0 ? 0 : lastFrame+frameInterval-now;
+    frameTimer.start(wait > 0 ? int((wait+999999)/1000000) : 0);
+}
+
+
+void
+RepaintScheduler::onFrame() {
+    qint64 now = clock.nsecsElapsed();
+    // Frame slots gone by since this frame was due (i.e. a slow paint
+    // or a busy event loop)
+    if(dirtySince >= 0) {
+        qint64 due = dirtySince;
+        if(lastFrame >= 0) due = qMax(due, lastFrame+frameInterval);
+        if(now > due) nSkipped += quint64((now-due)/frameInterval);
+    }
+    dirtySince = -1;
+    // Back from idle: the rate is measured from here
+    if(lastFrame < 0 || now-lastFrame > 1000000000) {
+        fpsWindowStart   = now;
+        nFpsWindowFrames = 0;
+    }
+    for(int i=0; i<targets.count(); i++) {
+        Target& target = targets[i];
+        if(!target.bDirty) continue;
+        target.bDirty = false;
+        if(target.pObject)
+            QMetaObject::invokeMethod(target.pObject, target.method.constData());
+    }
+    lastFrame = now;
+    nFrames++;
+    nFpsWindowFrames++;
+    if(now-fpsWindowStart >= 1000000000) {
+        currentFps = nFpsWindowFrames*1.0e9/double(now-fpsWindowStart);
+        fpsWindowStart   = now;
+        nFpsWindowFrames = 0;
+    }
+}
+
+
+// Frames per second over the last second with frames (0 when idle)
+double
+RepaintScheduler::fps() const {
+    qint64 now = clock.nsecsElapsed();
+    if(lastFrame < 0 || now-lastFrame > 1000000000) return 0.0;
+    return currentFps;
+}
+
+
+quint64
+RepaintScheduler::frames() const {
+    return nFrames;
+}
+
+
+quint64
+RepaintScheduler::skippedFrames() const {
+    return nSkipped;
+}
+
+
+quint64
+RepaintScheduler::coalescedMarks() const {
+    return nCoalesced;
+}
+
+
+void
+RepaintScheduler::resetCounters() {
+    nFrames          = 0;
+    nSkipped         = 0;
+    nCoalesced       = 0;
+    nFpsWindowFrames = 0;
+    fpsWindowStart   = clock.nsecsElapsed();
+    currentFps       = 0.0;
+}
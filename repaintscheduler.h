@@ -0,0 +1,73 @@
+/*
+ *
+Copyright (C) 2016  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QVector>
+#include <QPointer>
+
+
+// Coalesces the repaints of the widgets showing the telemetry: a widget
+// marked dirty is repainted at the next frame, no sooner than 1/maxFps
+// after the previous one (the display refresh rate by default). With no
+// widget dirty the timer stays stopped, so nothing is painted while no
+// data arrive.
+class RepaintScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit RepaintScheduler(QObject *parent = nullptr);
+
+    int  addTarget(QObject* pTarget, const char* pMethod);
+    void setMaxFps(double fps);
+    double maxFps() const;
+    void markDirty(int iTarget);
+
+    double  fps() const;
+    quint64 frames() const;
+    quint64 skippedFrames() const;
+    quint64 coalescedMarks() const;
+    void resetCounters();
+
+protected slots:
+    void onFrame();
+
+protected:
+    struct Target {
+        QPointer<QObject> pObject;
+        QByteArray method;    // Invoked without arguments (i.e. "update")
+        bool bDirty;
+    };
+    QVector<Target> targets;
+    QTimer        frameTimer;
+    QElapsedTimer clock;
+    qint64  frameInterval;    // ns
+    qint64  lastFrame;        // ns, -1 before the first frame
+    qint64  dirtySince;       // ns, -1 with nothing dirty
+    double  requestedFps;     // 0 = display refresh
+    quint64 nFrames;
+    quint64 nSkipped;
+    quint64 nCoalesced;
+    qint64  fpsWindowStart;   // ns
+    quint64 nFpsWindowFrames;
+    double  currentFps;
+};
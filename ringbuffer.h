@@ -0,0 +1,156 @@
+/*
+ *
+Copyright (C) 2016  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QVector>
+
+
+// Fixed capacity circular buffer.
+// Appending to a full buffer overwrites the oldest element, so both
+// append() and removeFirst() are O(1) whatever the capacity.
+// Element i (0 = oldest) lives at m_data[(m_head+i) % capacity]; the
+// stored elements are therefore always available as (at most) two
+// contiguous spans: [firstSpan(), firstSpan()+firstSpanCount()) and
+// [secondSpan(), secondSpan()+secondSpanCount()).
+template <typename T>
+class RingBuffer
+{
+public:
+    explicit RingBuffer(int capacity=0)
+        : m_head(0)
+        , m_count(0)
+    {
+        setCapacity(capacity);
+    }
+
+    // Changes the capacity keeping the newest elements.
+    void setCapacity(int capacity) {
+        if(capacity < 0) capacity = 0;
+        if(capacity == m_data.count()) return;
+        int nKeep = m_count < capacity ? m_count : capacity;
+        QVector<T> newData(capacity);
+        for(int i=0; i<nKeep; i++)
+            newData[i] = at(m_count-nKeep+i);
+        m_data  = newData;
+        m_head  = 0;
+        m_count = nKeep;
+    }
+
+    int capacity() const { return m_data.count(); }
+    int count() const { return m_count; }
+    bool isEmpty() const { return m_count == 0; }
+    bool isFull() const { return m_count == m_data.count(); }
+
+    void clear() {
+        m_head  = 0;
+        m_count = 0;
+    }
+
+    void append(const T& value) {
+        int iCapacity = m_data.count();
+        if(iCapacity == 0) return;
+        if(m_count < iCapacity) {
+            m_data[physical(m_count)] = value;
+            m_count++;
+        }
+        else {
+            m_data[m_head] = value;
+            m_head = (m_head+1 == iCapacity) ? 0 : m_head+1;
+        }
+    }
+
+    // Bulk append: only the newest capacity() values are kept
+    void append(const T* values, int n) {
+        int iCapacity = m_data.count();
+        if(iCapacity == 0 || n <= 0) return;
+        if(n > iCapacity) {
+            values += n-iCapacity;
+            n = iCapacity;
+        }
+        T* pData = m_data.data();
+        int iTail = physical(m_count < iCapacity ? m_count : 0);
+        int nFirst = iCapacity-iTail;
+        if(nFirst > n) nFirst = n;
+        for(int j=0; j<nFirst; j++) pData[iTail+j] = values[j];
+        for(int j=nFirst; j<n; j++) pData[j-nFirst] = values[j];
+        int nOverflow = m_count+n-iCapacity;
+        if(nOverflow > 0) {
+            m_head  = physical(nOverflow);
+            m_count = iCapacity;
+        }
+        else {
+            m_count += n;
+        }
+    }
+
+    void removeFirst() {
+        if(m_count == 0) return;
+        m_head = (m_head+1 == m_data.count()) ? 0 : m_head+1;
+        m_count--;
+    }
+
+    void removeLast() {
+        if(m_count == 0) return;
+        m_count--;
+    }
+
+    const T& at(int i) const { return m_data.at(physical(i)); }
+    const T& operator[](int i) const { return m_data.at(physical(i)); }
+    T& operator[](int i) { return m_data[physical(i)]; }
+    const T& first() const { return at(0); }
+    const T& last() const { return at(m_count-1); }
+
+    // Contiguous views of the stored elements (oldest first).
+    const T* firstSpan() const { return m_data.constData()+m_head; }
+    int firstSpanCount() const {
+        int iTail = m_data.count()-m_head;
+        return m_count < iTail ? m_count : iTail;
+    }
+    const T* secondSpan() const { return m_data.constData(); }
+    int secondSpanCount() const { return m_count-firstSpanCount(); }
+
+    // Contiguous view starting at element i: dataAt(i) holds
+    // contiguousCount(i) consecutive elements.
+    const T* dataAt(int i) const { return m_data.constData()+physical(i); }
+    int contiguousCount(int i) const {
+        int iTail = m_data.count()-physical(i);
+        return m_count-i < iTail ? m_count-i : iTail;
+    }
+
+    // Copies n elements starting from element i into dest
+    void copyTo(int i, int n, T* dest) const {
+        int iPos = physical(i);
+        int nFirst = m_data.count()-iPos;
+        if(nFirst > n) nFirst = n;
+        const T* pData = m_data.constData();
+        for(int j=0; j<nFirst; j++) dest[j] = pData[iPos+j];
+        for(int j=nFirst; j<n; j++) dest[j] = pData[j-nFirst];
+    }
+
+protected:
+    int physical(int i) const {
+        int iPos = m_head+i;
+        return iPos < m_data.count() ? iPos : iPos-m_data.count();
+    }
+
+protected:
+    QVector<T> m_data;
+    int m_head;
+    int m_count;
+};
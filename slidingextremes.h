@@ -0,0 +1,115 @@
+/*
+ *
+Copyright (C) 2016  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QtGlobal>
+
+#include "ringbuffer.h"
+
+
+// Minimum and maximum of the values inside a sliding window.
+// Every value is identified by its (increasing) sequence number; two
+// monotonic queues keep only the values that can still become the
+// window extreme, so append() and evict() are amortized O(1).
+class SlidingExtremes
+{
+public:
+    explicit SlidingExtremes(int capacity=0);
+    void setCapacity(int capacity);
+    void clear();
+    void evict(quint64 oldestSeq);
+    void append(quint64 seq, double value);
+    bool isEmpty() const;
+    double min() const;
+    double max() const;
+
+protected:
+    struct Entry {
+        quint64 seq;
+        double  value;
+    };
+    RingBuffer<Entry> minQueue; // Increasing values
+    RingBuffer<Entry> maxQueue; // Decreasing values
+};
+
+
+inline
+SlidingExtremes::SlidingExtremes(int capacity)
+    : minQueue(capacity)
+    , maxQueue(capacity)
+{
+}
+
+
+// Callers must evict() the values leaving the window before shrinking
+inline void
+SlidingExtremes::setCapacity(int capacity) {
+    minQueue.setCapacity(capacity);
+    maxQueue.setCapacity(capacity);
+}
+
+
+inline void
+SlidingExtremes::clear() {
+    minQueue.clear();
+    maxQueue.clear();
+}
+
+
+// Drops the values older than oldestSeq
+inline void
+SlidingExtremes::evict(quint64 oldestSeq) {
+    while(!minQueue.isEmpty() && minQueue.first().seq < oldestSeq)
+        minQueue.removeFirst();
+    while(!maxQueue.isEmpty() && maxQueue.first().seq < oldestSeq)
+        maxQueue.removeFirst();
+}
+
+
+// The window must already have room for the new value (see evict())
+inline void
+SlidingExtremes::append(quint64 seq, double value) {
+    Entry entry;
+    entry.seq   = seq;
+    entry.value = value;
+    while(!minQueue.isEmpty() && minQueue.last().value >= value)
+        minQueue.removeLast();
+    minQueue.append(entry);
+    while(!maxQueue.isEmpty() && maxQueue.last().value <= value)
+        maxQueue.removeLast();
+    maxQueue.append(entry);
+}
+
+
+inline bool
+SlidingExtremes::isEmpty() const {
+    return minQueue.isEmpty();
+}
+
+
+inline double
+SlidingExtremes::min() const {
+    return minQueue.first().value;
+}
+
+
+inline double
+SlidingExtremes::max() const {
+    return maxQueue.first().value;
+}
@@ -0,0 +1,76 @@
+/*
+ *
+Copyright (C) 2016  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QVector>
+#include <QAtomicInteger>
+
+
+// Bounded lock free queue for exactly one producer thread and one
+// consumer thread. The capacity is rounded up to a power of two.
+// iHead is written only by the consumer, iTail only by the producer
+// (free running counters, the unsigned difference is the count); the
+// acquire/release pairs make the element visible before the index.
+template <typename T>
+class SpscQueue
+{
+public:
+    explicit SpscQueue(int capacity=4096)
+        : iHead(0)
+        , iTail(0)
+    {
+        int iSize = 2;
+        while(iSize < capacity) iSize *= 2;
+        data.resize(iSize);
+        pData = data.data(); // Never detached by the two threads
+        iMask = quint32(iSize-1);
+    }
+
+    int capacity() const { return int(iMask+1); }
+
+    // Producer side: false when the queue is full (the value is dropped)
+    bool push(const T& value) {
+        quint32 iT = iTail.loadRelaxed();
+        if(iT-iHead.loadAcquire() > iMask) return false;
+        pData[iT & iMask] = value;
+        iTail.storeRelease(iT+1);
+        return true;
+    }
+
+    // Consumer side: false when the queue is empty
+    bool pop(T* pValue) {
+        quint32 iH = iHead.loadRelaxed();
+        if(iH == iTail.loadAcquire()) return false;
+        *pValue = pData[iH & iMask];
+        iHead.storeRelease(iH+1);
+        return true;
+    }
+
+    // Approximate when called while the other side is running
+    int count() const {
+        return int(iTail.loadAcquire()-iHead.loadAcquire());
+    }
+
+protected:
+    QVector<T> data;
+    T* pData;
+    quint32 iMask;
+    QAtomicInteger<quint32> iHead;
+    QAtomicInteger<quint32> iTail;
+};
@@ -0,0 +1,126 @@
+/*
+ *
+Copyright (C) 2016  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include "streamframer.h"
+#include "telemetryprotocol.h"
+
+#include <QIODevice>
+#include <string.h>
+
+
+StreamFramer::StreamFramer(int initialCapacity)
+    : iBegin(0)
+    , iEnd(0)
+    , iScan(0)
+{
+    buffer.resize(initialCapacity > 0 ? initialCapacity : 1024);
+}
+
+
+void
+StreamFramer::clear() {
+    iBegin = 0;
+    iEnd   = 0;
+    iScan  = 0;
+}
+
+
+int
+StreamFramer::pending() const {
+    return iEnd-iBegin;
+}
+
+
+// Room for nBytes more at the end of the buffer
+char*
+StreamFramer::reserve(int nBytes) {
+    if(iBegin == iEnd) {
+        clear();
+    }
+    if(buffer.size()-iEnd < nBytes && iBegin > 0) {
+        // Only the incomplete frame is moved
+        memmove(buffer.data(), buffer.constData()+iBegin, size_t(iEnd-iBegin));
+        iEnd  -= iBegin;
+        iScan -= iBegin;
+        iBegin = 0;
+    }
+    if(buffer.size()-iEnd < nBytes) {
+        int iCapacity = buffer.size();
+        while(iCapacity-iEnd < nBytes) iCapacity *= 2;
+        buffer.resize(iCapacity);
+    }
+    return buffer.data()+iEnd;
+}
+
+
+void
+StreamFramer::append(const char* pData, int nBytes) {
+    if(nBytes <= 0) return;
+    memcpy(reserve(nBytes), pData, size_t(nBytes));
+    iEnd += nBytes;
+}
+
+
+// Reads all the bytes available from pDevice
+qint64
+StreamFramer::readFrom(QIODevice* pDevice) {
+    qint64 nAvailable = pDevice->bytesAvailable();
+    if(nAvailable <= 0) return 0;
+    qint64 nRead = pDevice->read(reserve(int(nAvailable)), nAvailable);
+    if(nRead > 0) iEnd += int(nRead);
+    return nRead;
+}
+
+
+bool
+StreamFramer::nextFrame(const char** ppFrame, int* pnBytes) {
+    const char* pData = buffer.constData();
+    while(iBegin < iEnd) {
+        if(quint8(pData[iBegin]) == TELEMETRY_MAGIC_0) {
+            int nFrame = TelemetryBinaryFrameSize(pData+iBegin, iEnd-iBegin);
+            if(nFrame == 0) return false;
+            if(nFrame < 0) { // Not a valid header: skip the byte
+                iBegin++;
+                iScan = iBegin;
+                continue;
+            }
+            *ppFrame = pData+iBegin;
+            *pnBytes = nFrame;
+            iBegin += nFrame;
+            iScan = iBegin;
+            return true;
+        }
+        if(iScan < iBegin) iScan = iBegin;
+        for(; iScan<iEnd; iScan++) {
+            char c = pData[iScan];
+            if(c == '#') break;
+            if(quint8(c) == TELEMETRY_MAGIC_0) break;
+        }
+        if(iScan == iEnd) return false;
+        if(pData[iScan] != '#') { // A binary frame interrupted the message
+            iBegin = iScan;
+            continue;
+        }
+        iScan++;
+        *ppFrame = pData+iBegin;
+        *pnBytes = iScan-iBegin;
+        iBegin = iScan;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,52 @@
+/*
+ *
+Copyright (C) 2016  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QByteArray>
+
+
+QT_FORWARD_DECLARE_CLASS(QIODevice)
+
+
+// Splits a byte stream into telemetry frames (ASCII messages ended by
+// '#' or binary frames, see telemetryprotocol.h).
+// The bytes are received straight into a reusable buffer; every byte is
+// scanned only once and the frames are returned as views into the
+// buffer, valid until the next append(), readFrom() or clear().
+// The buffer is compacted only when there is no room at its end.
+class StreamFramer
+{
+public:
+    explicit StreamFramer(int initialCapacity=65536);
+
+    void clear();
+    void append(const char* pData, int nBytes);
+    qint64 readFrom(QIODevice* pDevice);
+    bool nextFrame(const char** ppFrame, int* pnBytes);
+    int pending() const;
+
+protected:
+    char* reserve(int nBytes);
+
+protected:
+    QByteArray buffer;
+    int iBegin; // First byte not yet returned
+    int iEnd;   // End of the received bytes
+    int iScan;  // Where to resume the search of the ASCII terminator
+};
@@ -0,0 +1,272 @@
+/*
+ *
+Copyright (C) 2016  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include "telemetryprotocol.h"
+
+#include <QtEndian>
+#include <QtNumeric>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+
+// Number of leading doubles in the binary payload of each message type
+static int
+leadingDoubles(char type) {
+    return (type == 'p') ? 1 : 0;
+}
+
+
+static const char*
+skipBlanks(const char* p, const char* pEnd) {
+    while(p < pEnd && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+        p++;
+    return p;
+}
+
+
+// Length of word (lower case) if the text at p starts with it, whatever
+// the case, 0 otherwise
+static int
+matchWord(const char* p, const char* pEnd, const char* word) {
+    int n = 0;
+    for(; word[n]; n++) {
+        if(p+n >= pEnd || (p[n] | 0x20) != word[n]) return 0;
+    }
+    return n;
+}
+
+
+// Locale independent, allocation free parsing of a decimal number.
+// "nan", "inf" and "infinity" (any case, with a sign) are accepted as
+// QString::toDouble() does. Returns the first character not used (p if
+// no number was found).
+static const char*
+parseNumber(const char* p, const char* pEnd, double* pValue) {
+    const char* pStart = p;
+    bool bNegative = false;
+    if(p < pEnd && (*p == '+' || *p == '-')) {
+        bNegative = (*p == '-');
+        p++;
+    }
+    int nWord;
+    if((nWord = matchWord(p, pEnd, "nan")) > 0) {
+        *pValue = qQNaN();
+        return p+nWord;
+    }
+    if((nWord = matchWord(p, pEnd, "infinity")) > 0 ||
+       (nWord = matchWord(p, pEnd, "inf")) > 0) {
+        *pValue = bNegative ? -qInf() : qInf();
+        return p+nWord;
+    }
+    quint64 mantissa = 0;
+    int iExponent = 0;
+    int nDigits = 0;
+    for(; p < pEnd && *p >= '0' && *p <= '9'; p++, nDigits++) {
+        if(mantissa < 100000000000000000ULL) mantissa = mantissa*10 + quint64(*p-'0');
+        else iExponent++;
+    }
+    if(p < pEnd && *p == '.') {
+        for(p++; p < pEnd && *p >= '0' && *p <= '9'; p++, nDigits++) {
+            if(mantissa < 100000000000000000ULL) {
+                mantissa = mantissa*10 + quint64(*p-'0');
+                iExponent--;
+            }
+        }
+    }
+    if(nDigits == 0) return pStart;
+    if(p < pEnd && (*p == 'e' || *p == 'E')) {
+        const char* pExp = p+1;
+        bool bNegExp = false;
+        if(pExp < pEnd && (*pExp == '+' || *pExp == '-')) {
+            bNegExp = (*pExp == '-');
+            pExp++;
+        }
+        if(pExp < pEnd && *pExp >= '0' && *pExp <= '9') {
+            int iExp = 0;
+            for(; pExp < pEnd && *pExp >= '0' && *pExp <= '9'; pExp++)
+                if(iExp < 10000) iExp = iExp*10 + (*pExp-'0');
+            iExponent += bNegExp ? -iExp : iExp;
+            p = pExp;
+        }
+    }
+    double value = double(mantissa);
+    if(iExponent < 0) value /= pow(10.0, -iExponent);
+    else if(iExponent > 0) value *= pow(10.0, iExponent);
+    *pValue = bNegative ? -value : value;
+    return p;
+}
+
+
+static int
+decodeAscii(const char* pData, int nBytes, TelemetryMessage* pMsg) {
+    const char* pEnd = static_cast<const char*>(memchr(pData, '#', size_t(nBytes)));
+    if(!pEnd) return 0;
+    int nConsumed = int(pEnd-pData)+1;
+    const char* p = skipBlanks(pData, pEnd);
+    if(p == pEnd) return nConsumed; // Empty message
+    pMsg->type        = *p;
+    pMsg->pText       = p;
+    pMsg->nTextLength = int(pEnd-p);
+    p++;
+    for(;;) {
+        p = skipBlanks(p, pEnd);
+        if(p == pEnd || pMsg->nValues == TELEMETRY_MAX_VALUES) break;
+        const char* pNext = parseNumber(p, pEnd, &pMsg->value[pMsg->nValues]);
+        if(pNext == p) break; // Not a number: the text is still available
+        pMsg->nValues++;
+        p = pNext;
+    }
+    return nConsumed;
+}
+
+
+int
+TelemetryBinaryFrameSize(const char* pData, int nBytes) {
+    if(nBytes < 2) return 0;
+    if(quint8(pData[0]) != TELEMETRY_MAGIC_0 ||
+       quint8(pData[1]) != TELEMETRY_MAGIC_1)
+        return -1;
+    if(nBytes < TELEMETRY_HEADER_SIZE) return 0;
+    int iVersion = quint8(pData[2]);
+    int nLength = qFromLittleEndian<quint16>(reinterpret_cast<const uchar*>(pData+4));
+    if(iVersion != TELEMETRY_VERSION ||
+       nLength > TELEMETRY_MAX_FRAME-TELEMETRY_HEADER_SIZE)
+        return -1;
+    if(nBytes < TELEMETRY_HEADER_SIZE+nLength) return 0;
+    return TELEMETRY_HEADER_SIZE+nLength;
+}
+
+
+static int
+decodeBinary(const char* pData, int nBytes, TelemetryMessage* pMsg) {
+    int nFrame = TelemetryBinaryFrameSize(pData, nBytes);
+    if(nFrame < 0) return 1; // Resynchronize
+    if(nFrame == 0) return 0;
+    char type = pData[3];
+    int nLength = nFrame-TELEMETRY_HEADER_SIZE;
+
+    const uchar* p = reinterpret_cast<const uchar*>(pData+TELEMETRY_HEADER_SIZE);
+    const uchar* pEnd = p+nLength;
+    int nDoubles = leadingDoubles(type);
+    pMsg->type = type;
+    pMsg->bBinary = true;
+    if(type == TELEMETRY_SEQUENCE) {
+        if(nLength >= 12) {
+            pMsg->value[0] = double(qFromLittleEndian<quint32>(p));
+            pMsg->value[1] = double(qFromLittleEndian<quint64>(p+4));
+            pMsg->nValues  = 2;
+        }
+        return TELEMETRY_HEADER_SIZE+nLength;
+    }
+    for(int i=0; i<nDoubles && p+8<=pEnd; i++, p+=8) {
+        quint64 bits = qFromLittleEndian<quint64>(p);
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        pMsg->value[pMsg->nValues++] = value;
+    }
+    for(; p+4<=pEnd && pMsg->nValues<TELEMETRY_MAX_VALUES; p+=4) {
+        quint32 bits = qFromLittleEndian<quint32>(p);
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        pMsg->value[pMsg->nValues++] = double(value);
+    }
+    return TELEMETRY_HEADER_SIZE+nLength;
+}
+
+
+int
+DecodeTelemetry(const char* pData, int nBytes, TelemetryMessage* pMsg) {
+    pMsg->type        = 0;
+    pMsg->nValues     = 0;
+    pMsg->pText       = nullptr;
+    pMsg->nTextLength = 0;
+    pMsg->bBinary     = false;
+    pMsg->readMicros   = 0;
+    pMsg->parsedMicros = 0;
+    if(nBytes <= 0) return 0;
+    if(quint8(pData[0]) == TELEMETRY_MAGIC_0)
+        return decodeBinary(pData, nBytes, pMsg);
+    // An ASCII message can never contain the magic byte: when one shows
+    // up before the '#' the bytes before it are garbage (i.e. a lost '#').
+    // Only this message is scanned, not the whole buffer.
+    const char* pHash = static_cast<const char*>(memchr(pData, '#', size_t(nBytes)));
+    int nScan = pHash ? int(pHash-pData) : nBytes;
+    const char* pMagic = static_cast<const char*>(memchr(pData, char(TELEMETRY_MAGIC_0), size_t(nScan)));
+    if(pMagic) {
+        int nAscii = decodeAscii(pData, int(pMagic-pData), pMsg);
+        return nAscii > 0 ? nAscii : int(pMagic-pData);
+    }
+    return decodeAscii(pData, nBytes, pMsg);
+}
+
+
+int
+EncodeTelemetryBinary(char type, const double* values, int nValues, char* pOut) {
+    if(nValues > TELEMETRY_MAX_VALUES) nValues = TELEMETRY_MAX_VALUES;
+    uchar* p = reinterpret_cast<uchar*>(pOut+TELEMETRY_HEADER_SIZE);
+    int nDoubles = leadingDoubles(type);
+    for(int i=0; i<nValues; i++) {
+        if(i < nDoubles) {
+            quint64 bits;
+            memcpy(&bits, &values[i], sizeof(bits));
+            qToLittleEndian<quint64>(bits, p);
+            p += 8;
+        }
+        else {
+            float value = float(values[i]);
+            quint32 bits;
+            memcpy(&bits, &value, sizeof(bits));
+            qToLittleEndian<quint32>(bits, p);
+            p += 4;
+        }
+    }
+    int nLength = int(p-reinterpret_cast<uchar*>(pOut))-TELEMETRY_HEADER_SIZE;
+    pOut[0] = char(TELEMETRY_MAGIC_0);
+    pOut[1] = char(TELEMETRY_MAGIC_1);
+    pOut[2] = char(TELEMETRY_VERSION);
+    pOut[3] = type;
+    qToLittleEndian<quint16>(quint16(nLength), reinterpret_cast<uchar*>(pOut+4));
+    return TELEMETRY_HEADER_SIZE+nLength;
+}
+
+
+int
+EncodeTelemetryAscii(char type, const double* values, int nValues, char* pOut) {
+    if(nValues > TELEMETRY_MAX_VALUES) nValues = TELEMETRY_MAX_VALUES;
+    int n = 0;
+    pOut[n++] = type;
+    for(int i=0; i<nValues; i++)
+        n += snprintf(pOut+n, 32, " %.9g", values[i]);
+    pOut[n++] = '#';
+    return n;
+}
+
+
+int
+EncodeTelemetrySequence(quint32 sequence, quint64 senderMicros, char* pOut) {
+    uchar* p = reinterpret_cast<uchar*>(pOut);
+    p[0] = TELEMETRY_MAGIC_0;
+    p[1] = TELEMETRY_MAGIC_1;
+    p[2] = TELEMETRY_VERSION;
+    p[3] = uchar(TELEMETRY_SEQUENCE);
+    qToLittleEndian<quint16>(12, p+4);
+    qToLittleEndian<quint32>(sequence, p+TELEMETRY_HEADER_SIZE);
+    qToLittleEndian<quint64>(senderMicros, p+TELEMETRY_HEADER_SIZE+4);
+    return TELEMETRY_HEADER_SIZE+12;
+}
@@ -0,0 +1,86 @@
+/*
+ *
+Copyright (C) 2016  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QtGlobal>
+
+
+//==============================================================
+// Telemetry messages can travel in two formats:
+//
+// ASCII  : "<type> <value> <value> ...#"   (e.g. "q w x y z#")
+//
+// Binary : offset  size  content
+//            0      2    magic (0xA5 0x5A)
+//            2      1    protocol version
+//            3      1    message type ('q', 'p', ...)
+//            4      2    payload length (little endian)
+//            6      n    payload (little endian)
+//          The payload of 'p' is a double (time) followed by floats
+//          (input and output); the payload of 'n' is a quint32 sequence
+//          number followed by a quint64 time (us); every other type
+//          carries floats only.
+//
+// A datagram may start with an 'n' message (sequence number and sender
+// time) used to compute the link statistics (see linkstatistics.h).
+//
+// The magic byte never appears in the ASCII messages, so both formats
+// may be mixed on the same stream. The binary format is requested by
+// the "B <version>#" order and acknowledged by the "b <version>#" reply.
+//==============================================================
+
+
+#define TELEMETRY_MAGIC_0      quint8(0xA5)
+#define TELEMETRY_MAGIC_1      quint8(0x5A)
+#define TELEMETRY_VERSION      1
+#define TELEMETRY_HEADER_SIZE  6
+#define TELEMETRY_MAX_VALUES   8
+#define TELEMETRY_MAX_FRAME    (TELEMETRY_HEADER_SIZE+TELEMETRY_MAX_VALUES*8)
+#define TELEMETRY_SEQUENCE     'n'
+
+
+// A decoded message. It never owns memory: the ASCII text, when present,
+// points into the buffer passed to DecodeTelemetry().
+struct TelemetryMessage
+{
+    char   type;                          // 0 when the bytes were skipped
+    int    nValues;
+    double value[TELEMETRY_MAX_VALUES];
+    const char* pText;                    // ASCII body (nullptr if binary)
+    int    nTextLength;
+    bool   bBinary;
+    quint64 readMicros;                   // Socket read (0 = unknown)
+    quint64 parsedMicros;                 // Decoded
+};
+
+
+// Decodes the first message found in pData. Returns the number of bytes
+// consumed (0 when more bytes are needed to complete the message).
+int DecodeTelemetry(const char* pData, int nBytes, TelemetryMessage* pMsg);
+
+// Size of the binary frame starting at pData: 0 when more bytes are
+// needed, -1 when pData does not start with a valid header.
+int TelemetryBinaryFrameSize(const char* pData, int nBytes);
+
+// Encoders (used by the test tools and to size the two formats).
+// Both return the number of bytes written into pOut, that must hold at
+// least TELEMETRY_MAX_FRAME bytes (ASCII: 32 bytes per value more).
+int EncodeTelemetryBinary(char type, const double* values, int nValues, char* pOut);
+int EncodeTelemetryAscii(char type, const double* values, int nValues, char* pOut);
+int EncodeTelemetrySequence(quint32 sequence, quint64 senderMicros, char* pOut);
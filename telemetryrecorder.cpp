@@ -0,0 +1,178 @@
+/*
+ *
+Copyright (C) 2016  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include "telemetryrecorder.h"
+
+#include <QtEndian>
+#include <string.h>
+
+
+// A time index entry every indexInterval us (at most)
+static const quint64 indexInterval = 100000;
+
+
+TelemetryRecorder::TelemetryRecorder()
+    : nSegmentSize(0)
+    , pMapped(nullptr)
+    , iPosition(0)
+    , iSegment(0)
+    , nRecorded(0)
+    , lastIndexMicros(0)
+{
+}
+
+
+TelemetryRecorder::~TelemetryRecorder() {
+    stop();
+}
+
+
+QString
+TelemetryRecorder::segmentPath(QString sBasePath, int iSegment) {
+    return QString("%1-%2.seg").arg(sBasePath).arg(iSegment, 4, 10, QChar('0'));
+}
+
+
+QString
+TelemetryRecorder::indexPath(QString sBasePath) {
+    return sBasePath + ".idx";
+}
+
+
+bool
+TelemetryRecorder::start(QString sBasePath, qint64 segmentSize) {
+    stop();
+    sBase        = sBasePath;
+    nSegmentSize = segmentSize;
+    iSegment     = 0;
+    nRecorded    = 0;
+    lastIndexMicros = 0;
+    pendingIndex.clear();
+    indexFile.setFileName(indexPath(sBase));
+    if(!indexFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    char magic[TELEMETRY_MAGIC_SIZE] = TELEMETRY_INDEX_MAGIC;
+    indexFile.write(magic, TELEMETRY_MAGIC_SIZE);
+    if(!openSegment()) {
+        indexFile.close();
+        return false;
+    }
+    return true;
+}
+
+
+void
+TelemetryRecorder::stop() {
+    if(!pMapped) return;
+    closeSegment();
+    flushIndex();
+    indexFile.close();
+}
+
+
+bool
+TelemetryRecorder::isRecording() const {
+    return pMapped != nullptr;
+}
+
+
+quint64
+TelemetryRecorder::recordedMessages() const {
+    return nRecorded;
+}
+
+
+QString
+TelemetryRecorder::basePath() const {
+    return sBase;
+}
+
+
+bool
+TelemetryRecorder::openSegment() {
+    segmentFile.setFileName(segmentPath(sBase, iSegment));
+    if(!segmentFile.open(QIODevice::ReadWrite | QIODevice::Truncate))
+        return false;
+    // The file size is reserved now: no syscalls while recording
+    if(!segmentFile.resize(nSegmentSize) ||
+       !(pMapped = segmentFile.map(0, nSegmentSize))) {
+        segmentFile.close();
+        segmentFile.remove();
+        return false;
+    }
+    memcpy(pMapped, TELEMETRY_LOG_MAGIC, TELEMETRY_MAGIC_SIZE);
+    iPosition = TELEMETRY_MAGIC_SIZE;
+    return true;
+}
+
+
+void
+TelemetryRecorder::closeSegment() {
+    if(!pMapped) return;
+    segmentFile.unmap(pMapped);
+    pMapped = nullptr;
+    // Room for the terminating zero length
+    segmentFile.resize(qMin(iPosition+TELEMETRY_RECORD_HEADER, nSegmentSize));
+    segmentFile.close();
+}
+
+
+// Index entries are written when a segment is closed and on stop()
+void
+TelemetryRecorder::flushIndex() {
+    for(int i=0; i<pendingIndex.count(); i++) {
+        uchar entry[16];
+        qToLittleEndian<quint64>(pendingIndex.at(i).micros,  entry);
+        qToLittleEndian<quint32>(pendingIndex.at(i).segment, entry+8);
+        qToLittleEndian<quint32>(pendingIndex.at(i).offset,  entry+12);
+        indexFile.write(reinterpret_cast<const char*>(entry), sizeof(entry));
+    }
+    pendingIndex.clear();
+    indexFile.flush();
+}
+
+
+void
+TelemetryRecorder::record(quint64 receiveMicros, const char* pFrame, int nBytes) {
+    if(!pMapped || nBytes <= 0 || nBytes > 0xFFFF) return;
+    qint64 nNeeded = TELEMETRY_RECORD_HEADER+nBytes;
+    if(iPosition+nNeeded+TELEMETRY_RECORD_HEADER > nSegmentSize) {
+        closeSegment();
+        flushIndex();
+        iSegment++;
+        if(!openSegment()) {
+            indexFile.close();
+            return; // Recording stops here
+        }
+        lastIndexMicros = 0;
+    }
+    if(lastIndexMicros == 0 || receiveMicros-lastIndexMicros >= indexInterval) {
+        TelemetryIndexEntry entry;
+        entry.micros  = receiveMicros;
+        entry.segment = quint32(iSegment);
+        entry.offset  = quint32(iPosition);
+        pendingIndex.append(entry);
+        lastIndexMicros = receiveMicros;
+    }
+    uchar* p = pMapped+iPosition;
+    qToLittleEndian<quint64>(receiveMicros, p);
+    qToLittleEndian<quint16>(quint16(nBytes), p+8);
+    memcpy(p+TELEMETRY_RECORD_HEADER, pFrame, size_t(nBytes));
+    iPosition += nNeeded;
+    nRecorded++;
+}
@@ -0,0 +1,91 @@
+/*
+ *
+Copyright (C) 2016  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+
+//==============================================================
+// A recorded session is made of:
+//
+// <base>-NNNN.seg  segments: the 8 bytes magic "SBRLOG1" followed by
+//                  the records, each one made of
+//                      quint64  receive time (us, little endian)
+//                      quint16  frame length (little endian)
+//                      frame    the message bytes as received
+//                  A zero length ends the records (a segment is
+//                  preallocated and truncated when closed).
+// <base>.idx       sparse time index: the 8 bytes magic "SBRIDX1"
+//                  followed by (quint64 time, quint32 segment,
+//                  quint32 offset) entries, little endian.
+//==============================================================
+
+
+#define TELEMETRY_LOG_MAGIC      "SBRLOG1"
+#define TELEMETRY_INDEX_MAGIC    "SBRIDX1"
+#define TELEMETRY_MAGIC_SIZE     8
+#define TELEMETRY_RECORD_HEADER  10
+
+
+struct TelemetryIndexEntry
+{
+    quint64 micros;
+    quint32 segment;
+    quint32 offset;
+};
+
+
+// Appends the received frames to memory mapped segments: the segments
+// are preallocated, so that recording a message is just a copy.
+// Not thread safe: it is used by the network worker only.
+class TelemetryRecorder
+{
+public:
+    TelemetryRecorder();
+    ~TelemetryRecorder();
+
+    bool start(QString sBasePath, qint64 segmentSize=64*1024*1024);
+    void stop();
+    bool isRecording() const;
+    void record(quint64 receiveMicros, const char* pFrame, int nBytes);
+    quint64 recordedMessages() const;
+    QString basePath() const;
+
+    static QString segmentPath(QString sBasePath, int iSegment);
+    static QString indexPath(QString sBasePath);
+
+protected:
+    bool openSegment();
+    void closeSegment();
+    void flushIndex();
+
+protected:
+    QString sBase;
+    qint64  nSegmentSize;
+    QFile   segmentFile;
+    QFile   indexFile;
+    uchar*  pMapped;
+    qint64  iPosition;
+    int     iSegment;
+    quint64 nRecorded;
+    quint64 lastIndexMicros;
+    QVector<TelemetryIndexEntry> pendingIndex;
+};
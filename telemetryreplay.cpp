@@ -0,0 +1,284 @@
+/*
+ *
+Copyright (C) 2016  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include "telemetryreplay.h"
+
+#include <QtEndian>
+#include <string.h>
+
+
+TelemetryLogReader::TelemetryLogReader()
+    : pMapped(nullptr)
+    , nMapped(0)
+    , iPosition(0)
+    , iSegment(0)
+    , startMicros(0)
+{
+}
+
+
+TelemetryLogReader::~TelemetryLogReader() {
+    close();
+}
+
+
+// "telemetry-...-0003.seg" or "telemetry-....idx" -> "telemetry-..."
+QString
+TelemetryLogReader::basePathOf(QString sFileName) {
+    if(sFileName.endsWith(".idx"))
+        return sFileName.left(sFileName.length()-4);
+    if(sFileName.endsWith(".seg"))
+        return sFileName.left(sFileName.length()-9);
+    return sFileName;
+}
+
+
+bool
+TelemetryLogReader::open(QString sBasePath) {
+    close();
+    sBase = sBasePath;
+    index.clear();
+    QFile indexFile(TelemetryRecorder::indexPath(sBase));
+    if(indexFile.open(QIODevice::ReadOnly)) {
+        QByteArray data = indexFile.readAll();
+        if(data.startsWith(TELEMETRY_INDEX_MAGIC)) {
+            const uchar* p = reinterpret_cast<const uchar*>(data.constData());
+            for(int i=TELEMETRY_MAGIC_SIZE; i+16<=data.size(); i+=16) {
+                TelemetryIndexEntry entry;
+                entry.micros  = qFromLittleEndian<quint64>(p+i);
+                entry.segment = qFromLittleEndian<quint32>(p+i+8);
+                entry.offset  = qFromLittleEndian<quint32>(p+i+12);
+                index.append(entry);
+            }
+        }
+    }
+    if(!rewind()) return false;
+    // The time of the first message
+    quint64 micros;
+    const char* pFrame;
+    int nBytes;
+    if(!next(&micros, &pFrame, &nBytes)) return false;
+    startMicros = micros;
+    return rewind();
+}
+
+
+void
+TelemetryLogReader::close() {
+    closeSegment();
+}
+
+
+quint64
+TelemetryLogReader::firstMicros() const {
+    return startMicros;
+}
+
+
+bool
+TelemetryLogReader::rewind() {
+    return openSegment(0);
+}
+
+
+// Positions the reader at the last indexed message not after micros
+bool
+TelemetryLogReader::seek(quint64 micros) {
+    int iFound = -1;
+    int iLow = 0, iHigh = index.count()-1;
+    while(iLow <= iHigh) {
+        int iMid = (iLow+iHigh)/2;
+        if(index.at(iMid).micros <= micros) {
+            iFound = iMid;
+            iLow = iMid+1;
+        }
+        else {
+            iHigh = iMid-1;
+        }
+    }
+    if(iFound < 0) return rewind();
+    if(!openSegment(int(index.at(iFound).segment))) return false;
+    iPosition = index.at(iFound).offset;
+    return true;
+}
+
+
+bool
+TelemetryLogReader::openSegment(int iNewSegment) {
+    closeSegment();
+    segmentFile.setFileName(TelemetryRecorder::segmentPath(sBase, iNewSegment));
+    if(!segmentFile.open(QIODevice::ReadOnly))
+        return false;
+    nMapped = segmentFile.size();
+    if(nMapped < TELEMETRY_MAGIC_SIZE ||
+       !(pMapped = segmentFile.map(0, nMapped)) ||
+       memcmp(pMapped, TELEMETRY_LOG_MAGIC, TELEMETRY_MAGIC_SIZE) != 0) {
+        closeSegment();
+        return false;
+    }
+    iSegment  = iNewSegment;
+    iPosition = TELEMETRY_MAGIC_SIZE;
+    return true;
+}
+
+
+void
+TelemetryLogReader::closeSegment() {
+    if(pMapped) {
+        segmentFile.unmap(pMapped);
+        pMapped = nullptr;
+    }
+    if(segmentFile.isOpen())
+        segmentFile.close();
+    nMapped = 0;
+}
+
+
+bool
+TelemetryLogReader::next(quint64* pMicros, const char** ppFrame, int* pnBytes) {
+    while(pMapped) {
+        if(iPosition+TELEMETRY_RECORD_HEADER <= nMapped) {
+            const uchar* p = pMapped+iPosition;
+            int nBytes = qFromLittleEndian<quint16>(p+8);
+            if(nBytes > 0 && iPosition+TELEMETRY_RECORD_HEADER+nBytes <= nMapped) {
+                *pMicros = qFromLittleEndian<quint64>(p);
+                *ppFrame = reinterpret_cast<const char*>(p+TELEMETRY_RECORD_HEADER);
+                *pnBytes = nBytes;
+                iPosition += TELEMETRY_RECORD_HEADER+nBytes;
+                return true;
+            }
+        }
+        // End of this segment: go on with the next one
+        if(!openSegment(iSegment+1))
+            return false;
+    }
+    return false;
+}
+
+
+TelemetryReplay::TelemetryReplay()
+    : bRunning(false)
+    , bAtEnd(true)
+    , bPending(false)
+    , replaySpeed(1.0)
+    , frameEnd(0)
+    , pendingMicros(0)
+    , pPendingFrame(nullptr)
+    , nPendingBytes(0)
+{
+}
+
+
+bool
+TelemetryReplay::start(QString sBasePath, double speed) {
+    stop();
+    if(!reader.open(sBasePath)) return false;
+    replaySpeed = speed;
+    frameEnd    = reader.firstMicros();
+    bRunning    = true;
+    bAtEnd      = false;
+    bPending    = false;
+    return true;
+}
+
+
+void
+TelemetryReplay::stop() {
+    reader.close();
+    bRunning = false;
+    bAtEnd   = true;
+    bPending = false;
+}
+
+
+bool
+TelemetryReplay::isRunning() const {
+    return bRunning;
+}
+
+
+double
+TelemetryReplay::speed() const {
+    return replaySpeed;
+}
+
+
+bool
+TelemetryReplay::atEnd() const {
+    return bAtEnd;
+}
+
+
+// Jumps to offsetMicros of recorded time from the first message: the
+// index gives the nearest earlier message, the rest is skipped here
+bool
+TelemetryReplay::seek(quint64 offsetMicros) {
+    if(!bRunning) return false;
+    quint64 target = reader.firstMicros()+offsetMicros;
+    if(!reader.seek(target)) {
+        stop();
+        return false;
+    }
+    frameEnd = target;
+    bAtEnd   = false;
+    bPending = false;
+    while(reader.next(&pendingMicros, &pPendingFrame, &nPendingBytes)) {
+        if(pendingMicros >= target) {
+            bPending = true;
+            return true;
+        }
+    }
+    bAtEnd = true;
+    return true;
+}
+
+
+// Recorded time replayed so far
+quint64
+TelemetryReplay::position() const {
+    return frameEnd-reader.firstMicros();
+}
+
+
+// The next frame ends frameMicros of recorded time later
+void
+TelemetryReplay::beginFrame(quint64 frameMicros) {
+    frameEnd += frameMicros;
+}
+
+
+// Messages of the current frame, in the recorded order
+bool
+TelemetryReplay::nextMessage(TelemetryMessage* pMsg) {
+    while(!bAtEnd) {
+        if(!bPending) {
+            if(!reader.next(&pendingMicros, &pPendingFrame, &nPendingBytes)) {
+                bAtEnd = true;
+                return false;
+            }
+            bPending = true;
+        }
+        if(pendingMicros > frameEnd)
+            return false;
+        bPending = false;
+        DecodeTelemetry(pPendingFrame, nPendingBytes, pMsg);
+        if(pMsg->type && pMsg->type != TELEMETRY_SEQUENCE)
+            return true;
+    }
+    return false;
+}
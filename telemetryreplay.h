@@ -0,0 +1,93 @@
+/*
+ *
+Copyright (C) 2016  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+#include "telemetryrecorder.h"
+#include "telemetryprotocol.h"
+
+
+// Reads back a session written by TelemetryRecorder.
+// One segment at a time is memory mapped; the frames returned are views
+// into the mapping, valid until the next call.
+class TelemetryLogReader
+{
+public:
+    TelemetryLogReader();
+    ~TelemetryLogReader();
+
+    bool open(QString sBasePath);
+    void close();
+    bool rewind();
+    bool seek(quint64 micros);
+    bool next(quint64* pMicros, const char** ppFrame, int* pnBytes);
+    quint64 firstMicros() const;
+
+    static QString basePathOf(QString sFileName);
+
+protected:
+    bool openSegment(int iSegment);
+    void closeSegment();
+
+protected:
+    QString sBase;
+    QFile   segmentFile;
+    uchar*  pMapped;
+    qint64  nMapped;
+    qint64  iPosition;
+    int     iSegment;
+    quint64 startMicros;
+    QVector<TelemetryIndexEntry> index;
+};
+
+
+// Deterministic playback: the recorded messages are returned in order,
+// in frames of recorded time. Whatever the speed, the same frames
+// always hold the same messages.
+class TelemetryReplay
+{
+public:
+    TelemetryReplay();
+
+    bool start(QString sBasePath, double speed);
+    void stop();
+    bool isRunning() const;
+    double speed() const;
+
+    bool seek(quint64 offsetMicros);
+    quint64 position() const;
+
+    void beginFrame(quint64 frameMicros);
+    bool nextMessage(TelemetryMessage* pMsg);
+    bool atEnd() const;
+
+protected:
+    TelemetryLogReader reader;
+    bool    bRunning;
+    bool    bAtEnd;
+    bool    bPending;     // A message read beyond the current frame
+    double  replaySpeed;  // 0 = as fast as possible
+    quint64 frameEnd;     // In recorded time
+    quint64 pendingMicros;
+    const char* pPendingFrame;
+    int     nPendingBytes;
+};
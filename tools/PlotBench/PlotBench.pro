@@ -0,0 +1,28 @@
+QT += core
+QT += gui
+
+
+CONFIG += c++11
+CONFIG += console
+CONFIG -= app_bundle
+
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+    ../../DataSetProperties.cpp \
+    ../../datastream2d.cpp \
+    ../../minmaxpyramid.cpp \
+    ../../plottransform.cpp \
+    main.cpp
+
+HEADERS += \
+    ../../DataSetProperties.h \
+    ../../datastream2d.h \
+    ../../minmaxpyramid.h \
+    ../../plottransform.h \
+    ../../ringbuffer.h \
+    ../../slidingextremes.h
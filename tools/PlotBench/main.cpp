@@ -0,0 +1,254 @@
+/*
+ *
+Copyright (C) 2016  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+// Benchmarks of the plot data path: the per sample cost must not grow
+// with the number of points kept in the plot window, and the window
+// bounds must be the ones a full rescan finds. The world to pixel
+// kernels are timed one by one.
+//   PlotBench [--max points] [--samples n]
+
+#include "datastream2d.h"
+#include "plottransform.h"
+#include "ringbuffer.h"
+#include "slidingextremes.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QVector>
+#include <math.h>
+
+
+// Defeats the optimizer
+static volatile double sink;
+
+
+static double
+sampleY(qint64 i) {
+    return double((i*7919) % 1000)*0.001;
+}
+
+
+// ns per appended sample, the window being already full
+static double
+benchRingBuffer(int nWindow, qint64 nSamples) {
+    RingBuffer<double> ring(nWindow);
+    for(int i=0; i<nWindow; i++) ring.append(sampleY(i));
+    QElapsedTimer timer;
+    timer.start();
+    for(qint64 i=0; i<nSamples; i++) ring.append(sampleY(i));
+    double ns = double(timer.nsecsElapsed());
+    sink = ring.last();
+    return ns/double(nSamples);
+}
+
+
+// The whole AddPoint(): storage, window bounds and decimation levels
+static double
+benchDataStream(int nWindow, qint64 nSamples) {
+    DataStream2D stream(1, 1, QColor(255, 255, 255), 1, "Bench");
+    stream.setMaxPoints(nWindow);
+    QVector<double> x(nWindow), y(nWindow);
+    for(int i=0; i<nWindow; i++) {
+        x[i] = i;
+        y[i] = sampleY(i);
+    }
+    stream.AddPoints(x.constData(), y.constData(), nWindow);
+    QElapsedTimer timer;
+    timer.start();
+    for(qint64 i=nWindow; i<nWindow+nSamples; i++) stream.AddPoint(double(i), sampleY(i));
+    double ns = double(timer.nsecsElapsed());
+    sink = stream.maxy;
+    return ns/double(nSamples);
+}
+
+
+// The storage used before the ring buffer: every eviction shifts the
+// whole window
+static double
+benchShiftingVector(int nWindow, qint64 nSamples) {
+    QVector<double> vector;
+    vector.reserve(nWindow+1);
+    for(int i=0; i<nWindow; i++) vector.append(sampleY(i));
+    QElapsedTimer timer;
+    timer.start();
+    for(qint64 i=0; i<nSamples; i++) {
+        vector.append(sampleY(i));
+        vector.removeFirst();
+    }
+    double ns = double(timer.nsecsElapsed());
+    sink = vector.last();
+    return ns/double(nSamples);
+}
+
+
+// Window bounds as computed before SlidingExtremes: a rescan of the
+// whole window after every eviction. Returns ns per sample; the bounds
+// of the last window go to pMin/pMax.
+static double
+benchRescan(int nWindow, qint64 nSamples, double* pMin, double* pMax) {
+    RingBuffer<double> ring(nWindow);
+    for(int i=0; i<nWindow; i++) ring.append(sampleY(i));
+    double yMin = 0.0, yMax = 0.0;
+    QElapsedTimer timer;
+    timer.start();
+    for(qint64 i=nWindow; i<nWindow+nSamples; i++) {
+        ring.append(sampleY(i));
+        yMin = yMax = ring.at(0);
+        for(int j=1; j<ring.count(); j++) {
+            double y = ring.at(j);
+            if(y < yMin) yMin = y;
+            if(y > yMax) yMax = y;
+        }
+    }
+    double ns = double(timer.nsecsElapsed());
+    *pMin = yMin;
+    *pMax = yMax;
+    return ns/double(nSamples);
+}
+
+
+// The same bounds from the monotonic queues
+static double
+benchSlidingExtremes(int nWindow, qint64 nSamples, double* pMin, double* pMax) {
+    SlidingExtremes extremes(nWindow);
+    for(int i=0; i<nWindow; i++) extremes.append(quint64(i), sampleY(i));
+    QElapsedTimer timer;
+    timer.start();
+    for(qint64 i=nWindow; i<nWindow+nSamples; i++) {
+        extremes.evict(quint64(i-nWindow+1));
+        extremes.append(quint64(i), sampleY(i));
+        sink = extremes.min()+extremes.max();
+    }
+    double ns = double(timer.nsecsElapsed());
+    *pMin = extremes.min();
+    *pMax = extremes.max();
+    return ns/double(nSamples);
+}
+
+
+// Millions of points per second through one kernel, in blocks of a
+// typical window size; the largest difference from the scalar kernel
+// goes to pMaxError (pixels).
+static double
+benchTransform(TransformKernel kernel, bool bLog, qint64 nPoints, double* pMaxError) {
+    const int nBlock = 4096;
+    QVector<double> x(nBlock), y(nBlock);
+    for(int i=0; i<nBlock; i++) {
+        x[i] = 1.0+i;
+        y[i] = 0.001+sampleY(i);
+    }
+    PlotTransform t;
+    t.xOrigin = bLog ? 0.0 : 1.0;
+    t.xScale  = bLog ? 200.0 : 0.25;
+    t.xOffset = 40.0;
+    t.yOrigin = bLog ? -3.0 : 0.0;
+    t.yScale  = -120.0;
+    t.yOffset = 500.0;
+    t.bLogX = t.bLogY = bLog;
+    QVector<QPointF> reference(nBlock), points(nBlock);
+    TransformPoints(t, x.constData(), y.constData(), nBlock, reference.data(), kernelScalar);
+    TransformPoints(t, x.constData(), y.constData(), nBlock, points.data(), kernel);
+    double maxError = 0.0;
+    for(int i=0; i<nBlock; i++) {
+        maxError = qMax(maxError, fabs(points.at(i).x()-reference.at(i).x()));
+        maxError = qMax(maxError, fabs(points.at(i).y()-reference.at(i).y()));
+    }
+    *pMaxError = maxError;
+    qint64 nBlocks = qMax(qint64(1), nPoints/nBlock);
+    QElapsedTimer timer;
+    timer.start();
+    for(qint64 i=0; i<nBlocks; i++)
+        TransformPoints(t, x.constData(), y.constData(), nBlock, points.data(), kernel);
+    double ns = double(timer.nsecsElapsed());
+    sink = points.at(nBlock-1).y();
+    return double(nBlocks*nBlock)*1.0e3/ns;
+}
+
+
+int
+main(int argc, char *argv[]) {
+    QCoreApplication a(argc, argv);
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Plot data path benchmarks");
+    parser.addHelpOption();
+    parser.addOption({"max",     "Largest plot window (points).",    "points", "10000000"});
+    parser.addOption({"samples", "Samples timed for every window.",  "n",      "2000000"});
+    parser.process(a);
+
+    int nMax = qMax(1000, parser.value("max").toInt());
+    qint64 nSamples = qMax(qint64(1000), parser.value("samples").toLongLong());
+    QTextStream out(stdout);
+
+    // The QVector path is O(window): it is timed on fewer samples and
+    // only up to 100k points
+    out << "Append to a full window (ns/sample)" << Qt::endl;
+    out << QString("%1 %2 %3 %4").arg("Window", 10).arg("RingBuffer", 12)
+           .arg("DataStream2D", 14).arg("QVector (old)", 15) << Qt::endl;
+    for(qint64 nWindow=1000; nWindow<=nMax; nWindow*=10) {
+        int n = int(nWindow);
+        QString sOld = "-";
+        if(n <= 100000) {
+            qint64 nOldSamples = qMax(qint64(1000), qMin(nSamples, qint64(200000000)/n));
+            sOld = QString("%1").arg(benchShiftingVector(n, nOldSamples), 0, 'f', 1);
+        }
+        out << QString("%1 %2 %3 %4").arg(n, 10)
+               .arg(benchRingBuffer(n, nSamples), 12, 'f', 1)
+               .arg(benchDataStream(n, nSamples), 14, 'f', 1)
+               .arg(sOld, 15) << Qt::endl;
+    }
+
+    // The rescan is O(window): timed on fewer samples
+    out << Qt::endl << "Window bounds after an append (ns/sample)" << Qt::endl;
+    out << QString("%1 %2 %3 %4").arg("Window", 10).arg("Rescan (old)", 14)
+           .arg("SlidingExtremes", 17).arg("Same bounds", 13) << Qt::endl;
+    for(int nWindow=10000; nWindow<=1000000; nWindow*=10) {
+        qint64 nRescanSamples = qMax(qint64(100), qMin(nSamples, qint64(200000000)/nWindow));
+        double rescanMin, rescanMax, slidingMin, slidingMax;
+        double nsRescan = benchRescan(nWindow, nRescanSamples, &rescanMin, &rescanMax);
+        // Same samples for the comparison, all of them for the timing
+        benchSlidingExtremes(nWindow, nRescanSamples, &slidingMin, &slidingMax);
+        bool bSame = (rescanMin == slidingMin) && (rescanMax == slidingMax);
+        double nsSliding = benchSlidingExtremes(nWindow, nSamples, &slidingMin, &slidingMax);
+        out << QString("%1 %2 %3 %4").arg(nWindow, 10)
+               .arg(nsRescan, 14, 'f', 1)
+               .arg(nsSliding, 17, 'f', 1)
+               .arg(bSame ? "yes" : "NO", 13) << Qt::endl;
+    }
+
+    out << Qt::endl << "World to pixel transform (Mpoints/s)" << Qt::endl;
+    out << QString("%1 %2 %3 %4").arg("Kernel", 10).arg("Linear", 10)
+           .arg("Log", 10).arg("Max error (px)", 16) << Qt::endl;
+    const TransformKernel kernels[3] = { kernelScalar, kernelSse2, kernelAvx2 };
+    const char* kernelName[3] = { "Scalar", "SSE2", "AVX2" };
+    for(int k=0; k<3; k++) {
+        if(!TransformKernelAvailable(kernels[k])) {
+            out << QString("%1 %2").arg(kernelName[k], 10).arg("not available", 14) << Qt::endl;
+            continue;
+        }
+        double linearError, logError;
+        double linear = benchTransform(kernels[k], false, 20*nSamples, &linearError);
+        double log    = benchTransform(kernels[k], true,  20*nSamples, &logError);
+        out << QString("%1 %2 %3 %4").arg(kernelName[k], 10)
+               .arg(linear, 10, 'f', 0)
+               .arg(log, 10, 'f', 0)
+               .arg(qMax(linearError, logError), 16, 'g', 2) << Qt::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,49 @@
+QT += core
+QT += gui
+QT += widgets
+
+
+CONFIG += c++11
+CONFIG += console
+CONFIG -= app_bundle
+
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+    ../../AxisFrame.cpp \
+    ../../AxisLimits.cpp \
+    ../../DataSetProperties.cpp \
+    ../../axesdialog.cpp \
+    ../../datastream2d.cpp \
+    ../../minmaxpyramid.cpp \
+    ../../plot2d.cpp \
+    ../../plotgllayer.cpp \
+    ../../plotpropertiesdlg.cpp \
+    ../../plottransform.cpp \
+    ../../telemetryprotocol.cpp \
+    ../../telemetryrecorder.cpp \
+    ../../telemetryreplay.cpp \
+    ../../utilities.cpp \
+    main.cpp
+
+HEADERS += \
+    ../../AxisFrame.h \
+    ../../AxisLimits.h \
+    ../../DataSetProperties.h \
+    ../../axesdialog.h \
+    ../../datastream2d.h \
+    ../../minmaxpyramid.h \
+    ../../plot2d.h \
+    ../../plotgllayer.h \
+    ../../plotpropertiesdlg.h \
+    ../../plottransform.h \
+    ../../ringbuffer.h \
+    ../../slidingextremes.h \
+    ../../telemetryprotocol.h \
+    ../../telemetryrecorder.h \
+    ../../telemetryreplay.h \
+    ../../utilities.h
@@ -0,0 +1,106 @@
+/*
+ *
+Copyright (C) 2016  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include "plot2d.h"
+#include "telemetryreplay.h"
+#include "utilities.h"
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QTextStream>
+#include <QVector>
+
+
+// Renders the PID plot of a recorded session into an image file, with
+// no window (run it with QT_QPA_PLATFORM=offscreen on a headless box).
+// With --repeat it also times the rendering, for the benchmarks.
+int
+main(int argc, char *argv[]) {
+    QApplication a(argc, argv);
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Self Balancing Robot plot export");
+    parser.addHelpOption();
+    parser.addPositionalArgument("session", "Base path of the recorded session.");
+    parser.addOption({"output", "Image file to write.",              "file",   "plot.png"});
+    parser.addOption({"size",   "Image size in logical pixels.",     "WxH",    "1280x720"});
+    parser.addOption({"dpr",    "Device pixel ratio of the image.",  "ratio",  "1"});
+    parser.addOption({"repeat", "Renderings to time (benchmark).",   "n",      "1"});
+    parser.process(a);
+
+    if(parser.positionalArguments().count() != 1)
+        parser.showHelp(1);
+    QString sBasePath = TelemetryLogReader::basePathOf(parser.positionalArguments().at(0));
+    QStringList sizes = parser.value("size").split('x');
+    QSize imageSize(sizes.value(0).toInt(), sizes.value(1).toInt());
+    qreal dpr = qMax(0.1, parser.value("dpr").toDouble());
+    int nRepeat = qMax(1, parser.value("repeat").toInt());
+    if(imageSize.isEmpty()) {
+        QTextStream(stderr) << "Wrong image size " << parser.value("size") << Qt::endl;
+        return 1;
+    }
+
+    // The whole session in a single frame
+    TelemetryReplay replay;
+    if(!replay.start(sBasePath, 0.0)) {
+        QTextStream(stderr) << "Unable to open " << sBasePath << Qt::endl;
+        return 1;
+    }
+    replay.beginFrame(Q_UINT64_C(0xFFFFFFFFFFFFFFFF));
+    QVector<double> pidTime, pidInput, pidOutput;
+    TelemetryMessage msg;
+    while(replay.nextMessage(&msg)) {
+        if(msg.type == 'p' && msg.nValues == 3) {
+            pidTime.append(msg.value[0]);
+            pidInput.append(msg.value[1]);
+            pidOutput.append(msg.value[2]);
+        }
+    }
+    replay.stop();
+    if(pidTime.isEmpty()) {
+        QTextStream(stderr) << "No PID samples in " << sBasePath << Qt::endl;
+        return 1;
+    }
+
+    Plot2D plot(nullptr, "Plot");
+    plot.NewDataSet(4, 1, QColor(255, 255, 255), Plot2D::ipoint, "PID-In");
+    plot.NewDataSet(5, 1, QColor(255, 255,  64), Plot2D::ipoint, "PID-Out");
+    plot.SetShowTitle(4, true);
+    plot.SetShowTitle(5, true);
+    plot.setMaxPoints(pidTime.count());
+    plot.SetLimits(-1.0, 1.0, -1.0, 1.0, true, true, false, false);
+    plot.NewPoints(4, pidTime.constData(), pidInput.constData(), pidTime.count());
+    plot.NewPoints(5, pidTime.constData(), pidOutput.constData(), pidTime.count());
+    plot.SetShowDataSet(4, true);
+    plot.SetShowDataSet(5, true);
+
+    QImage image;
+    quint64 t0 = micros();
+    for(int i=0; i<nRepeat; i++)
+        image = plot.renderToImage(imageSize, dpr);
+    quint64 elapsed = micros()-t0;
+
+    QString sOutput = parser.value("output");
+    if(!image.save(sOutput)) {
+        QTextStream(stderr) << "Unable to write " << sOutput << Qt::endl;
+        return 1;
+    }
+    QTextStream(stdout) << pidTime.count() << " samples rendered in "
+                        << double(elapsed)/(1000.0*nRepeat) << " ms"
+                        << " (mean of " << nRepeat << ")" << Qt::endl;
+    return 0;
+}
@@ -0,0 +1,27 @@
+QT += core
+QT += network
+QT -= gui
+
+
+CONFIG += c++11
+CONFIG += console
+CONFIG -= app_bundle
+
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+    ../../streamframer.cpp \
+    ../../telemetryprotocol.cpp \
+    ../../utilities.cpp \
+    main.cpp \
+    robotsimulator.cpp
+
+HEADERS += \
+    ../../streamframer.h \
+    ../../telemetryprotocol.h \
+    ../../utilities.h \
+    robotsimulator.h
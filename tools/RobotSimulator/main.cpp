@@ -0,0 +1,62 @@
+/*
+ *
+Copyright (C) 2016  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include "robotsimulator.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTextStream>
+
+
+int
+main(int argc, char *argv[]) {
+    QCoreApplication a(argc, argv);
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Self Balancing Robot simulator");
+    parser.addHelpOption();
+    parser.addOption({"port",      "TCP port for the remote orders.",        "port",  "43210"});
+    parser.addOption({"rate",      "Samples per second (100 to 10000).",     "rate",  "100"});
+    parser.addOption({"transport", "tcp, udp or both.",                      "mode",  "tcp"});
+    parser.addOption({"udp-host",  "UDP destination (default: the remote).", "address"});
+    parser.addOption({"udp-port",  "UDP destination port.",                  "port",  "37755"});
+    parser.addOption({"pattern",   "steady, burst, stall or disconnect.",    "name",  "steady"});
+    parser.addOption({"period",    "Pattern period in seconds.",             "s",     "10"});
+    parser.process(a);
+
+    RobotSimulator simulator;
+    simulator.setRate(parser.value("rate").toDouble());
+    QString sTransport = parser.value("transport");
+    simulator.setTransport(sTransport != "udp", sTransport != "tcp");
+    if(parser.isSet("udp-host"))
+        simulator.setUdpTarget(QHostAddress(parser.value("udp-host")),
+                               quint16(parser.value("udp-port").toUInt()));
+    QString sPattern = parser.value("pattern");
+    RobotSimulator::Pattern pattern = RobotSimulator::patternSteady;
+    if(sPattern == "burst")           pattern = RobotSimulator::patternBurst;
+    else if(sPattern == "stall")      pattern = RobotSimulator::patternStall;
+    else if(sPattern == "disconnect") pattern = RobotSimulator::patternDisconnect;
+    simulator.setPattern(pattern, parser.value("period").toDouble());
+
+    quint16 port = quint16(parser.value("port").toUInt());
+    if(!simulator.start(port)) {
+        QTextStream(stderr) << "Unable to listen on port " << port << Qt::endl;
+        return 1;
+    }
+    QTextStream(stdout) << "Robot simulator listening on port " << port << Qt::endl;
+    return a.exec();
+}
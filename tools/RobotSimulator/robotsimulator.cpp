@@ -0,0 +1,310 @@
+/*
+ *
+Copyright (C) 2016  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include "robotsimulator.h"
+#include "telemetryprotocol.h"
+#include "utilities.h"
+
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QUdpSocket>
+#include <QCoreApplication>
+#include <QTextStream>
+#include <QStringList>
+#include <math.h>
+
+
+// Largest UDP datagram sent (several messages are packed in one)
+#define MAX_DATAGRAM 1400
+
+
+RobotSimulator::RobotSimulator(QObject *parent)
+    : QObject(parent)
+    , pClient(nullptr)
+    , udpPort(37755)
+    , bUdpTargetSet(false)
+    , bTcp(true)
+    , bUdp(false)
+    , bBinary(false)
+    , udpSequence(0)
+    , sampleRate(100.0)
+    , pattern(patternSteady)
+    , patternPeriod(10.0)
+    , t0(0)
+    , lastTick(0)
+    , samplesDue(0.0)
+    , simTime(0.0)
+    , bPIDInControl(false)
+    , Kp(1.0)
+    , Ki(0.0)
+    , Kd(0.0)
+    , setpoint(0.0)
+    , speedL(0.0)
+    , speedR(0.0)
+    , angle(0.1)
+    , angularSpeed(0.0)
+    , integral(0.0)
+    , lastError(0.0)
+    , output(0.0)
+{
+    pServer    = new QTcpServer(this);
+    pUdpSocket = new QUdpSocket(this);
+    connect(pServer, SIGNAL(newConnection()),
+            this, SLOT(onNewConnection()));
+    tickTimer.setTimerType(Qt::PreciseTimer);
+    connect(&tickTimer, SIGNAL(timeout()),
+            this, SLOT(onTick()));
+}
+
+
+bool
+RobotSimulator::start(quint16 tcpPort) {
+    if(!pServer->listen(QHostAddress::Any, tcpPort))
+        return false;
+    t0 = lastTick = micros();
+    tickTimer.start(1); // The samples due are sent every millisecond
+    return true;
+}
+
+
+void
+RobotSimulator::setRate(double rate) {
+    sampleRate = qBound(1.0, rate, 100000.0);
+}
+
+
+void
+RobotSimulator::setTransport(bool bUseTcp, bool bUseUdp) {
+    bTcp = bUseTcp;
+    bUdp = bUseUdp;
+}
+
+
+void
+RobotSimulator::setUdpTarget(QHostAddress address, quint16 port) {
+    udpAddress    = address;
+    udpPort       = port;
+    bUdpTargetSet = true;
+}
+
+
+void
+RobotSimulator::setPattern(Pattern newPattern, double periodSeconds) {
+    pattern       = newPattern;
+    patternPeriod = qMax(3.0, periodSeconds);
+}
+
+
+void
+RobotSimulator::onNewConnection() {
+    QTcpSocket* pSocket = pServer->nextPendingConnection();
+    if(pClient) { // Only one remote at a time
+        pSocket->close();
+        pSocket->deleteLater();
+        return;
+    }
+    pClient = pSocket;
+    pClient->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    connect(pClient, SIGNAL(readyRead()),
+            this, SLOT(onReadyRead()));
+    connect(pClient, SIGNAL(disconnected()),
+            this, SLOT(onDisconnected()));
+    if(!bUdpTargetSet)
+        udpAddress = pClient->peerAddress();
+    bBinary = false;
+    orders.clear();
+    QTextStream(stdout) << "Remote connected from " << pClient->peerAddress().toString() << Qt::endl;
+}
+
+
+void
+RobotSimulator::onDisconnected() {
+    if(!pClient) return;
+    pClient->deleteLater();
+    pClient = nullptr;
+    tcpOut.clear();
+    QTextStream(stdout) << "Remote disconnected" << Qt::endl;
+}
+
+
+void
+RobotSimulator::onReadyRead() {
+    orders.readFrom(pClient);
+    const char* pFrame;
+    int nBytes;
+    while(orders.nextFrame(&pFrame, &nBytes))
+        executeOrder(QByteArray(pFrame, nBytes-1)); // Without the '#'
+}
+
+
+void
+RobotSimulator::executeOrder(const QByteArray& order) {
+    QList<QByteArray> tokens = order.trimmed().split(' ');
+    if(tokens.isEmpty() || tokens.at(0).isEmpty()) return;
+    char cmd = tokens.at(0).at(0);
+    if(cmd == 'G') {        // Set PID Control
+        bPIDInControl = true;
+        integral  = 0.0;
+        lastError = 0.0;
+    }
+    else if(cmd == 'S') {   // Set Manual Control
+        bPIDInControl = false;
+    }
+    else if(cmd == 'P') {   // PID Values
+        if(tokens.count() == 5) {
+            Kp       = tokens.at(1).toDouble();
+            Ki       = tokens.at(2).toDouble();
+            Kd       = tokens.at(3).toDouble();
+            setpoint = tokens.at(4).toDouble();
+        }
+    }
+    else if(cmd == 'C') {   // Ask Configuration
+        double config[6] = { Kp, Ki, Kd, 1.0, 1.0, setpoint };
+        char buffer[TELEMETRY_MAX_FRAME+6*32];
+        int n = EncodeTelemetryAscii('c', config, 6, buffer);
+        pClient->write(buffer, n);
+    }
+    else if(cmd == 'M') {   // Start Moving
+        if(tokens.count() == 3) {
+            speedL = tokens.at(1).toDouble();
+            speedR = tokens.at(2).toDouble();
+        }
+    }
+    else if(cmd == 'H') {   // Stop Moving
+        speedL = speedR = 0.0;
+    }
+    else if(cmd == 'K') {   // Kill
+        QTextStream(stdout) << "Killed by the remote" << Qt::endl;
+        QCoreApplication::quit();
+    }
+    else if(cmd == 'B') {   // Binary Telemetry
+        if(tokens.count() == 2 && tokens.at(1).toInt() == TELEMETRY_VERSION) {
+            double version = TELEMETRY_VERSION;
+            char buffer[64];
+            int n = EncodeTelemetryAscii('b', &version, 1, buffer);
+            pClient->write(buffer, n);
+            bBinary = true;
+        }
+    }
+    else if(cmd == 'E') {   // Echo (round trip measure)
+        if(tokens.count() == 2) {
+            double id = tokens.at(1).toDouble();
+            char buffer[64];
+            int n = EncodeTelemetryAscii('e', &id, 1, buffer);
+            pClient->write(buffer, n);
+        }
+    }
+}
+
+
+// Inverted pendulum: theta'' = g/l*sin(theta) - k*theta' - b*u
+void
+RobotSimulator::step(double dt) {
+    double error = setpoint-angle;
+    if(bPIDInControl) {
+        integral += error*dt;
+        double derivative = (error-lastError)/dt;
+        output = qBound(-1.0, Kp*error + Ki*integral + Kd*derivative, 1.0);
+        lastError = error;
+    }
+    else {
+        output = 0.5*(speedL+speedR);
+    }
+    double noise = 0.02*sin(37.0*simTime)*sin(3.1*simTime);
+    double acceleration = 9.81/0.3*sin(angle) - 0.5*angularSpeed - 60.0*output + noise;
+    angularSpeed += acceleration*dt;
+    angle += angularSpeed*dt;
+    // Fallen: the robot is put up again
+    if(fabs(angle) > 1.2) {
+        angle = 0.1*(angle > 0.0 ? -1.0 : 1.0);
+        angularSpeed = 0.0;
+        integral = 0.0;
+    }
+    simTime += dt;
+}
+
+
+void
+RobotSimulator::sendMessage(char type, const double* values, int nValues) {
+    char buffer[TELEMETRY_MAX_FRAME+TELEMETRY_MAX_VALUES*32];
+    int n = bBinary ? EncodeTelemetryBinary(type, values, nValues, buffer)
+                    : EncodeTelemetryAscii(type, values, nValues, buffer);
+    if(bTcp && pClient)
+        tcpOut.append(buffer, n);
+    if(bUdp) {
+        if(udpOut.size()+n > MAX_DATAGRAM)
+            flush();
+        if(udpOut.isEmpty()) {
+            char header[TELEMETRY_HEADER_SIZE+12];
+            int nHeader = EncodeTelemetrySequence(udpSequence++, micros(), header);
+            udpOut.append(header, nHeader);
+        }
+        udpOut.append(buffer, n);
+    }
+}
+
+
+void
+RobotSimulator::sendSample() {
+    step(1.0/sampleRate);
+    // Rotation of angle around the X axis
+    double q[4] = { cos(0.5*angle), sin(0.5*angle), 0.0, 0.0 };
+    double pid[3] = { simTime, angle, output };
+    sendMessage('q', q, 4);
+    sendMessage('p', pid, 3);
+}
+
+
+void
+RobotSimulator::flush() {
+    if(!tcpOut.isEmpty() && pClient) {
+        pClient->write(tcpOut);
+        tcpOut.clear();
+    }
+    if(!udpOut.isEmpty()) {
+        pUdpSocket->writeDatagram(udpOut, udpAddress, udpPort);
+        udpOut.clear();
+    }
+}
+
+
+void
+RobotSimulator::onTick() {
+    quint64 now = micros();
+    double dt = (now-lastTick)*1.0e-6;
+    lastTick = now;
+    if(!pClient && !bUdpTargetSet) return; // Nobody to send to
+
+    double phase = fmod((now-t0)*1.0e-6, patternPeriod);
+    double rate = sampleRate;
+    if(pattern == patternBurst && phase < 1.0)
+        rate *= 10.0;
+    samplesDue += rate*dt;
+    if(pattern == patternStall && phase < 2.0)
+        return; // The samples pile up and leave all together
+    if(pattern == patternDisconnect && phase < dt && pClient) {
+        QTextStream(stdout) << "Dropping the connection" << Qt::endl;
+        pClient->abort();
+        return;
+    }
+    int nSamples = int(samplesDue);
+    samplesDue -= nSamples;
+    for(int i=0; i<nSamples; i++)
+        sendSample();
+    flush();
+}
@@ -0,0 +1,96 @@
+/*
+ *
+Copyright (C) 2016  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QObject>
+#include <QTimer>
+#include <QHostAddress>
+#include <QByteArray>
+
+#include "streamframer.h"
+
+
+QT_FORWARD_DECLARE_CLASS(QTcpServer)
+QT_FORWARD_DECLARE_CLASS(QTcpSocket)
+QT_FORWARD_DECLARE_CLASS(QUdpSocket)
+
+
+// Stand in for the Robot: accepts the remote orders on TCP 43210 and
+// streams a simulated balancing run ('q' and 'p' messages) over TCP
+// and/or UDP 37755.
+class RobotSimulator : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Pattern {
+        patternSteady,
+        patternBurst,      // Ten times the rate for one second every period
+        patternStall,      // Two seconds of silence, then the backlog at once
+        patternDisconnect  // The TCP connection is dropped every period
+    };
+
+    explicit RobotSimulator(QObject *parent = nullptr);
+
+    bool start(quint16 tcpPort);
+    void setRate(double rate);
+    void setTransport(bool bTcp, bool bUdp);
+    void setUdpTarget(QHostAddress address, quint16 port);
+    void setPattern(Pattern newPattern, double periodSeconds);
+
+protected slots:
+    void onNewConnection();
+    void onReadyRead();
+    void onDisconnected();
+    void onTick();
+
+protected:
+    void executeOrder(const QByteArray& order);
+    void step(double dt);
+    void sendSample();
+    void sendMessage(char type, const double* values, int nValues);
+    void flush();
+
+protected:
+    QTcpServer*  pServer;
+    QTcpSocket*  pClient;
+    QUdpSocket*  pUdpSocket;
+    QHostAddress udpAddress;
+    quint16      udpPort;
+    bool         bUdpTargetSet;
+    bool         bTcp, bUdp;
+    bool         bBinary;
+    StreamFramer orders;
+    QTimer       tickTimer;
+    QByteArray   tcpOut, udpOut;
+    quint32      udpSequence;
+
+    double  sampleRate;
+    Pattern pattern;
+    double  patternPeriod;
+    quint64 t0, lastTick;
+    double  samplesDue;
+    double  simTime;
+
+    // Simulated robot
+    bool   bPIDInControl;
+    double Kp, Ki, Kd, setpoint;
+    double speedL, speedR;
+    double angle, angularSpeed, integral, lastError, output;
+};
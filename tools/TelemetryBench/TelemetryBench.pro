@@ -0,0 +1,22 @@
+QT += core
+QT -= gui
+
+
+CONFIG += c++11
+CONFIG += console
+CONFIG -= app_bundle
+
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+    ../../streamframer.cpp \
+    ../../telemetryprotocol.cpp \
+    main.cpp
+
+HEADERS += \
+    ../../streamframer.h \
+    ../../telemetryprotocol.h
@@ -0,0 +1,298 @@
+/*
+ *
+Copyright (C) 2016  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+// Benchmarks of the telemetry ingest: the binary and the ASCII message
+// formats (bytes per sample, messages per second), against the QString
+// parsing they replaced, and the TCP stream framing of 1 MB bursts.
+// The non finite values are checked to survive both formats first.
+//   TelemetryBench [--messages n] [--check]
+
+#include "streamframer.h"
+#include "telemetryprotocol.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QTextStream>
+#include <QtNumeric>
+#include <math.h>
+#include <string.h>
+
+
+// Defeats the optimizer
+static volatile double sink;
+
+
+// The same run of alternated 'q' and 'p' samples in every format
+static void
+sampleValues(int i, char* pType, double* values, int* pnValues) {
+    double t = i*0.001;
+    if(i % 2 == 0) {
+        *pType = 'q';
+        values[0] = cos(0.5*t);
+        values[1] = sin(0.5*t);
+        values[2] = 0.25*sin(0.3*t);
+        values[3] = 0.125*cos(0.7*t);
+        *pnValues = 4;
+    }
+    else {
+        *pType = 'p';
+        values[0] = t;
+        values[1] = 0.1*sin(7.0*t);
+        values[2] = 0.05*cos(3.0*t);
+        *pnValues = 3;
+    }
+}
+
+
+// Encodes nMessages samples; returns the ns spent
+static double
+encodeRun(bool bBinary, int nMessages, QByteArray* pStream) {
+    pStream->resize(nMessages*(TELEMETRY_MAX_FRAME+TELEMETRY_MAX_VALUES*32));
+    char* pOut = pStream->data();
+    char type;
+    double values[TELEMETRY_MAX_VALUES];
+    int nValues;
+    QElapsedTimer timer;
+    timer.start();
+    for(int i=0; i<nMessages; i++) {
+        sampleValues(i, &type, values, &nValues);
+        pOut += bBinary ? EncodeTelemetryBinary(type, values, nValues, pOut)
+                        : EncodeTelemetryAscii(type, values, nValues, pOut);
+    }
+    double ns = double(timer.nsecsElapsed());
+    pStream->resize(int(pOut-pStream->constData()));
+    return ns;
+}
+
+
+// Decodes the whole stream nRepeat times; returns the ns spent
+static double
+decodeRun(const QByteArray& stream, int nRepeat, int* pnMessages) {
+    TelemetryMessage msg;
+    int nMessages = 0;
+    QElapsedTimer timer;
+    timer.start();
+    for(int r=0; r<nRepeat; r++) {
+        const char* pData = stream.constData();
+        int nBytes = stream.size();
+        int nUsed;
+        while(nBytes > 0 && (nUsed = DecodeTelemetry(pData, nBytes, &msg)) > 0) {
+            if(msg.type) nMessages++;
+            pData  += nUsed;
+            nBytes -= nUsed;
+        }
+        sink = msg.value[0];
+    }
+    double ns = double(timer.nsecsElapsed());
+    *pnMessages = nMessages;
+    return ns;
+}
+
+
+// The ASCII parsing before DecodeTelemetry(): one QString per message,
+// split in tokens converted by toDouble()
+static double
+decodeQStringRun(const QByteArray& stream, int nRepeat, int* pnMessages) {
+    int nMessages = 0;
+    QElapsedTimer timer;
+    timer.start();
+    for(int r=0; r<nRepeat; r++) {
+        int iStart = 0;
+        int iPos;
+        while((iPos = stream.indexOf('#', iStart)) != -1) {
+            QString sCommand = QString::fromLatin1(stream.constData()+iStart, iPos-iStart);
+            QStringList tokens = sCommand.split(' ');
+            tokens.removeFirst();
+            double value = 0.0;
+            for(int i=0; i<tokens.count(); i++)
+                value += tokens.at(i).toDouble();
+            sink = value;
+            nMessages++;
+            iStart = iPos+1;
+        }
+    }
+    double ns = double(timer.nsecsElapsed());
+    *pnMessages = nMessages;
+    return ns;
+}
+
+
+// Bursts of burstSize bytes of stream are fed to the framer in chunks
+// of a TCP segment, the frames being taken after every chunk as the
+// network worker does. Returns the ns spent.
+static double
+framerRun(const QByteArray& stream, int burstSize, int chunkSize, qint64 nBursts,
+          qint64* pnFrames, qint64* pnBytes)
+{
+    StreamFramer framer;
+    qint64 nFrames = 0, nBytes = 0;
+    const char* pFrame;
+    int nFrame;
+    int iOffset = 0;
+    QElapsedTimer timer;
+    timer.start();
+    for(qint64 b=0; b<nBursts; b++) {
+        for(int iSent=0; iSent<burstSize; iSent+=chunkSize) {
+            int n = qMin(chunkSize, burstSize-iSent);
+            // The stream is looped over without cutting its frames
+            while(n > 0) {
+                int nCopy = qMin(n, stream.size()-iOffset);
+                framer.append(stream.constData()+iOffset, nCopy);
+                iOffset += nCopy;
+                if(iOffset == stream.size()) iOffset = 0;
+                nBytes += nCopy;
+                n -= nCopy;
+            }
+            while(framer.nextFrame(&pFrame, &nFrame)) {
+                nFrames++;
+                sink = pFrame[nFrame-1];
+            }
+        }
+    }
+    double ns = double(timer.nsecsElapsed());
+    *pnFrames = nFrames;
+    *pnBytes  = nBytes;
+    return ns;
+}
+
+
+static bool
+sameValue(double a, double b) {
+    return (qIsNaN(a) && qIsNaN(b)) || a == b;
+}
+
+
+// Decodes text and compares the values with expected
+static bool
+checkDecode(const char* text, const double* expected, int nExpected) {
+    TelemetryMessage msg;
+    DecodeTelemetry(text, int(strlen(text)), &msg);
+    if(msg.nValues != nExpected) return false;
+    for(int i=0; i<nExpected; i++)
+        if(!sameValue(msg.value[i], expected[i])) return false;
+    return true;
+}
+
+
+// NaN and infinities through the encoders and back, and the spellings
+// QString::toDouble() used to accept
+static bool
+checkNonFinite(QTextStream& out) {
+    const double nan = qQNaN();
+    const double inf = qInf();
+    bool bOk = true;
+    const double values[4] = { nan, inf, -inf, 1.5 };
+    for(int iFormat=0; iFormat<2; iFormat++) {
+        char buffer[TELEMETRY_MAX_FRAME+TELEMETRY_MAX_VALUES*32+1];
+        int n = iFormat ? EncodeTelemetryBinary('q', values, 4, buffer)
+                        : EncodeTelemetryAscii('q', values, 4, buffer);
+        TelemetryMessage msg;
+        DecodeTelemetry(buffer, n, &msg);
+        bool bSame = msg.nValues == 4;
+        for(int i=0; bSame && i<4; i++)
+            bSame = sameValue(msg.value[i], values[i]);
+        if(!bSame) {
+            out << (iFormat ? "Binary" : "ASCII") << " round trip of nan/inf failed" << Qt::endl;
+            bOk = false;
+        }
+    }
+    const double tInNan[3]  = { 1.0, 0.5, nan };
+    const double tNanOut[3] = { 1.0, nan, 0.5 };
+    const double signs[4]   = { inf, -inf, inf, -inf };
+    const double mixed[3]   = { nan, nan, -inf };
+    struct { const char* text; const double* values; int nValues; } cases[5] = {
+        { "p 1 0.5 nan#",                       tInNan,  3 },
+        { "p 1 nan 0.5#",                       tNanOut, 3 },
+        { "q inf -inf +Infinity -INFINITY#",    signs,   4 },
+        { "q NaN -nan -Inf#",                   mixed,   3 },
+        { "q +inf -infinity INF -inf#",         signs,   4 }
+    };
+    for(int i=0; i<5; i++) {
+        if(!checkDecode(cases[i].text, cases[i].values, cases[i].nValues)) {
+            out << "Wrong decoding of \"" << cases[i].text << "\"" << Qt::endl;
+            bOk = false;
+        }
+    }
+    return bOk;
+}
+
+
+int
+main(int argc, char *argv[]) {
+    QCoreApplication a(argc, argv);
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Telemetry ingest benchmarks");
+    parser.addHelpOption();
+    parser.addOption({"messages", "Messages decoded by every run.", "n", "4000000"});
+    parser.addOption({"bursts",   "1 MB bursts fed to the framer.", "n", "64"});
+    parser.addOption({"chunk",    "Bytes per read from the socket.", "bytes", "1448"});
+    parser.addOption({"check",    "Only check the non finite values."});
+    parser.process(a);
+
+    qint64 nTotal = qMax(qint64(1000), parser.value("messages").toLongLong());
+    const int nStream = 100000; // Messages encoded once, decoded repeatedly
+    int nRepeat = int(qMax(qint64(1), nTotal/nStream));
+    QTextStream out(stdout);
+
+    if(!checkNonFinite(out)) return 1;
+    out << "nan/inf round trip: ok" << Qt::endl;
+    if(parser.isSet("check")) return 0;
+
+    QByteArray binaryStream, asciiStream;
+    double nsBinaryEncode = encodeRun(true,  nStream, &binaryStream);
+    double nsAsciiEncode  = encodeRun(false, nStream, &asciiStream);
+    int nBinary, nAscii, nQString;
+    double nsBinary  = decodeRun(binaryStream, nRepeat, &nBinary);
+    double nsAscii   = decodeRun(asciiStream,  nRepeat, &nAscii);
+    // The QString path is timed on a single pass
+    double nsQString = decodeQStringRun(asciiStream, 1, &nQString);
+
+    out << QString("%1 %2 %3 %4").arg("Format", 16).arg("Bytes/sample", 14)
+           .arg("Encode (Mmsg/s)", 17).arg("Decode (Mmsg/s)", 17) << Qt::endl;
+    out << QString("%1 %2 %3 %4").arg("Binary", 16)
+           .arg(double(binaryStream.size())/nStream, 14, 'f', 1)
+           .arg(nStream*1.0e3/nsBinaryEncode, 17, 'f', 2)
+           .arg(nBinary*1.0e3/nsBinary, 17, 'f', 2) << Qt::endl;
+    out << QString("%1 %2 %3 %4").arg("ASCII", 16)
+           .arg(double(asciiStream.size())/nStream, 14, 'f', 1)
+           .arg(nStream*1.0e3/nsAsciiEncode, 17, 'f', 2)
+           .arg(nAscii*1.0e3/nsAscii, 17, 'f', 2) << Qt::endl;
+    out << QString("%1 %2 %3 %4").arg("ASCII (QString)", 16)
+           .arg(double(asciiStream.size())/nStream, 14, 'f', 1)
+           .arg("-", 17)
+           .arg(nQString*1.0e3/nsQString, 17, 'f', 2) << Qt::endl;
+
+    const int burstSize = 1024*1024;
+    qint64 nBursts  = qMax(qint64(1), parser.value("bursts").toLongLong());
+    int chunkSize   = qMax(1, parser.value("chunk").toInt());
+    out << Qt::endl << QString("1 MB bursts in %1 byte reads").arg(chunkSize) << Qt::endl;
+    out << QString("%1 %2 %3").arg("Stream", 16).arg("MB/s", 10).arg("Mframes/s", 11) << Qt::endl;
+    for(int iFormat=0; iFormat<2; iFormat++) {
+        const QByteArray& stream = iFormat ? binaryStream : asciiStream;
+        qint64 nFrames, nBytes;
+        double ns = framerRun(stream, burstSize, chunkSize, nBursts, &nFrames, &nBytes);
+        out << QString("%1 %2 %3").arg(iFormat ? "Binary" : "ASCII", 16)
+               .arg(nBytes*1.0e3/ns, 10, 'f', 0)
+               .arg(nFrames*1.0e3/ns, 11, 'f', 2) << Qt::endl;
+    }
+    return 0;
+}
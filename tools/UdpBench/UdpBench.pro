@@ -0,0 +1,36 @@
+QT += core
+QT += network
+QT -= gui
+
+
+CONFIG += c++11
+CONFIG += console
+CONFIG -= app_bundle
+
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+    ../../commandscheduler.cpp \
+    ../../latencyhistogram.cpp \
+    ../../linkstatistics.cpp \
+    ../../networkworker.cpp \
+    ../../streamframer.cpp \
+    ../../telemetryprotocol.cpp \
+    ../../telemetryrecorder.cpp \
+    ../../utilities.cpp \
+    main.cpp
+
+HEADERS += \
+    ../../commandscheduler.h \
+    ../../latencyhistogram.h \
+    ../../linkstatistics.h \
+    ../../networkworker.h \
+    ../../spscqueue.h \
+    ../../streamframer.h \
+    ../../telemetryprotocol.h \
+    ../../telemetryrecorder.h \
+    ../../utilities.h
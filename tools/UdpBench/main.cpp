@@ -0,0 +1,175 @@
+/*
+ *
+Copyright (C) 2016  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+// Loopback benchmark of the two NetworkWorker UDP receive paths, the
+// recvmmsg() batches and the QUdpSocket datagrams: a thread sends the
+// sequence numbered 'p' and 'q' datagrams of UdpSender as fast as it
+// can while the samples are drained as the GUI does. The rate is the
+// one of the slower of the two ends.
+//   UdpBench [--count n] [--port port] [--ascii]
+
+#include "networkworker.h"
+#include "telemetryprotocol.h"
+#include "utilities.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QUdpSocket>
+#include <QHostAddress>
+#include <QThread>
+#include <QMetaObject>
+#include <QTextStream>
+#include <math.h>
+
+
+class SenderThread : public QThread
+{
+public:
+    SenderThread(quint16 port, quint64 nCount, bool bAscii)
+        : port(port)
+        , nCount(nCount)
+        , bAscii(bAscii)
+    {
+    }
+
+protected:
+    void run() override {
+        QUdpSocket socket;
+        char datagram[3*TELEMETRY_MAX_FRAME+128];
+        for(quint64 seq=0; seq<nCount; seq++) {
+            double t = seq*1.0e-3;
+            double pid[3] = { t, sin(t), 0.5*cos(t) };
+            double q[4]   = { cos(0.5*t), 0.0, sin(0.5*t), 0.0 };
+            int n = EncodeTelemetrySequence(quint32(seq), micros(), datagram);
+            if(bAscii) {
+                n += EncodeTelemetryAscii('p', pid, 3, datagram+n);
+                n += EncodeTelemetryAscii('q', q, 4, datagram+n);
+            }
+            else {
+                n += EncodeTelemetryBinary('p', pid, 3, datagram+n);
+                n += EncodeTelemetryBinary('q', q, 4, datagram+n);
+            }
+            socket.writeDatagram(datagram, n, QHostAddress::LocalHost, port);
+        }
+    }
+
+protected:
+    quint16 port;
+    quint64 nCount;
+    bool    bAscii;
+};
+
+
+struct UdpResult
+{
+    bool    bBatch;      // The recvmmsg() socket could be opened
+    quint64 nReceived;   // Datagrams
+    quint64 nDropped;    // Samples lost to a full queue
+    double  seconds;     // From the first send to the last read
+};
+
+
+// The samples are drained until nothing arrives for a while after the
+// sender is done: the datagrams lost in the socket buffer never come
+static UdpResult
+runReceiver(bool bBatchReceive, quint16 port, quint64 nCount, bool bAscii) {
+    UdpResult result;
+    QThread workerThread;
+    NetworkWorker* pWorker = new NetworkWorker(port);
+    pWorker->setBatchReceive(bBatchReceive);
+    pWorker->moveToThread(&workerThread);
+    workerThread.start();
+    QMetaObject::invokeMethod(pWorker, "start", Qt::BlockingQueuedConnection);
+    result.bBatch = pWorker->isBatchReceive();
+
+    SenderThread sender(port, nCount, bAscii);
+    TelemetryMessage sample;
+    quint64 lastRead = 0;
+    quint64 t0 = micros();
+    quint64 tIdle = t0;
+    sender.start();
+    for(;;) {
+        pWorker->armSamplesAvailable();
+        bool bAny = false;
+        while(pWorker->popSample(&sample)) {
+            lastRead = sample.readMicros;
+            bAny = true;
+        }
+        quint64 tNow = micros();
+        if(bAny || sender.isRunning())
+            tIdle = tNow;
+        else if(tNow-tIdle > 200000)
+            break;
+        else
+            QThread::usleep(100);
+    }
+    sender.wait();
+
+    QMetaObject::invokeMethod(pWorker, "stop", Qt::BlockingQueuedConnection);
+    result.nReceived = pWorker->linkStats().nReceived;
+    result.nDropped  = pWorker->droppedSamples();
+    result.seconds   = lastRead > t0 ? (lastRead-t0)*1.0e-6 : 0.0;
+    workerThread.quit();
+    workerThread.wait();
+    delete pWorker;
+    return result;
+}
+
+
+int
+main(int argc, char *argv[]) {
+    QCoreApplication a(argc, argv);
+    QCommandLineParser parser;
+    parser.setApplicationDescription("UDP telemetry receive benchmark");
+    parser.addHelpOption();
+    parser.addOption({"count", "Datagrams sent to each receive path.", "n", "200000"});
+    parser.addOption({"port",  "Loopback UDP port.", "port", "37756"});
+    parser.addOption({"ascii", "Send the ASCII messages."});
+    parser.process(a);
+
+    quint64 nCount = qMax(quint64(1), parser.value("count").toULongLong());
+    quint16 port   = quint16(parser.value("port").toUInt());
+    bool bAscii    = parser.isSet("ascii");
+
+    QTextStream out(stdout);
+    out << QString("%1 datagrams of 'p' and 'q' %2 messages over loopback")
+           .arg(nCount).arg(bAscii ? "ASCII" : "binary") << Qt::endl;
+    out << QString("%1 %2 %3 %4 %5")
+           .arg("Receive path", 14)
+           .arg("Received", 10)
+           .arg("Lost (%)", 9)
+           .arg("Dropped", 9)
+           .arg("kdatagrams/s", 13) << Qt::endl;
+    for(int iPath=0; iPath<2; iPath++) {
+        bool bBatchReceive = (iPath == 0);
+        UdpResult result = runReceiver(bBatchReceive, port, nCount, bAscii);
+        if(bBatchReceive && !result.bBatch) {
+            out << QString("%1 %2").arg("recvmmsg", 14).arg("not available") << Qt::endl;
+            continue;
+        }
+        double lost = 100.0*(nCount-result.nReceived)/nCount;
+        double rate = result.seconds > 0.0 ? result.nReceived*1.0e-3/result.seconds : 0.0;
+        out << QString("%1 %2 %3 %4 %5")
+               .arg(bBatchReceive ? "recvmmsg" : "QUdpSocket", 14)
+               .arg(result.nReceived, 10)
+               .arg(lost, 9, 'f', 2)
+               .arg(result.nDropped, 9)
+               .arg(rate, 13, 'f', 1) << Qt::endl;
+    }
+    return 0;
+}
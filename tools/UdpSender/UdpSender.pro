@@ -0,0 +1,23 @@
+QT += core
+QT += network
+QT -= gui
+
+
+CONFIG += c++11
+CONFIG += console
+CONFIG -= app_bundle
+
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+    ../../telemetryprotocol.cpp \
+    ../../utilities.cpp \
+    main.cpp
+
+HEADERS += \
+    ../../telemetryprotocol.h \
+    ../../utilities.h
@@ -0,0 +1,114 @@
+/*
+ *
+Copyright (C) 2016  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+// Stand in for the Robot UDP telemetry: sends sequence numbered 'p'
+// and 'q' datagrams to the remote, optionally losing, reordering and
+// duplicating some of them, to check the link statistics.
+
+#include "telemetryprotocol.h"
+#include "utilities.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QUdpSocket>
+#include <QHostAddress>
+#include <QThread>
+#include <QRandomGenerator>
+#include <QTextStream>
+#include <math.h>
+
+
+int
+main(int argc, char *argv[]) {
+    QCoreApplication a(argc, argv);
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Sequence numbered UDP telemetry sender");
+    parser.addHelpOption();
+    parser.addOption({"host",      "Destination address.",           "address", "127.0.0.1"});
+    parser.addOption({"port",      "Destination UDP port.",          "port",    "37755"});
+    parser.addOption({"rate",      "Datagrams per second.",          "rate",    "1000"});
+    parser.addOption({"count",     "Datagrams to send (0 = forever).", "count", "0"});
+    parser.addOption({"loss",      "Probability of losing a datagram.",       "p", "0"});
+    parser.addOption({"reorder",   "Probability of delaying a datagram.",     "p", "0"});
+    parser.addOption({"duplicate", "Probability of sending a datagram twice.", "p", "0"});
+    parser.addOption({"ascii",     "Send the ASCII messages."});
+    parser.process(a);
+
+    QHostAddress address(parser.value("host"));
+    quint16 port       = quint16(parser.value("port").toUInt());
+    double rate        = qMax(1.0, parser.value("rate").toDouble());
+    quint64 nCount     = parser.value("count").toULongLong();
+    double lossP       = parser.value("loss").toDouble();
+    double reorderP    = parser.value("reorder").toDouble();
+    double duplicateP  = parser.value("duplicate").toDouble();
+    bool bAscii        = parser.isSet("ascii");
+
+    QUdpSocket socket;
+    QRandomGenerator* pRandom = QRandomGenerator::global();
+    QByteArray delayed;     // Datagram held back to be sent after the next one
+    char datagram[3*TELEMETRY_MAX_FRAME+128];
+    quint64 nLost = 0, nReordered = 0, nDuplicated = 0;
+    quint64 t0 = micros();
+
+    for(quint32 seq=0; nCount==0 || seq<nCount; seq++) {
+        // Keep the requested rate
+        quint64 tNext = t0 + quint64(seq*1.0e6/rate);
+        quint64 tNow = micros();
+        if(tNext > tNow) QThread::usleep(tNext-tNow);
+
+        double t = (micros()-t0)*1.0e-6;
+        double pid[3] = { t, sin(t), 0.5*cos(t) };
+        double q[4]   = { cos(0.5*t), 0.0, sin(0.5*t), 0.0 };
+        int n = EncodeTelemetrySequence(seq, micros(), datagram);
+        if(bAscii) {
+            n += EncodeTelemetryAscii('p', pid, 3, datagram+n);
+            n += EncodeTelemetryAscii('q', q, 4, datagram+n);
+        }
+        else {
+            n += EncodeTelemetryBinary('p', pid, 3, datagram+n);
+            n += EncodeTelemetryBinary('q', q, 4, datagram+n);
+        }
+
+        if(pRandom->generateDouble() < lossP) {
+            nLost++;
+            continue;
+        }
+        if(delayed.isEmpty() && pRandom->generateDouble() < reorderP) {
+            delayed = QByteArray(datagram, n);
+            nReordered++;
+            continue;
+        }
+        socket.writeDatagram(datagram, n, address, port);
+        if(pRandom->generateDouble() < duplicateP) {
+            socket.writeDatagram(datagram, n, address, port);
+            nDuplicated++;
+        }
+        if(!delayed.isEmpty()) {
+            socket.writeDatagram(delayed, address, port);
+            delayed.clear();
+        }
+        if((seq+1) % quint32(rate) == 0) {
+            QTextStream(stdout) << "sent " << seq+1
+                                << " lost " << nLost
+                                << " reordered " << nReordered
+                                << " duplicated " << nDuplicated << Qt::endl;
+        }
+    }
+    return 0;
+}
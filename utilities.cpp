@@ -1,8 +1,9 @@
 #include "utilities.h"
 
+// Monotonic: the latencies must not jump with the wall clock
 uint64_t
 micros() {
-    struct timeval tv;
-    gettimeofday(&tv, nullptr);
-    return tv.tv_sec*(uint64_t)1000000+tv.tv_usec;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*(uint64_t)1000000+ts.tv_nsec/1000;
 }